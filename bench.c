@@ -0,0 +1,127 @@
+// Throughput of the escape kernels in every precision. Renders the same view
+// through render_iterations() once per precision and reports samples and
+// iterations per second, no window needed. Then computes a perturbation
+// reference orbit at every precision level, at an interior point so it runs
+// the full length.
+//
+// Usage: ./bench [-j threads] [-i iterations] [-s size] [-e bla-epsilon]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "kernel.h"
+#include "pool.h"
+#include "render.h"
+
+#define BENCH_CAMERA_X -0.7436447860L
+#define BENCH_CAMERA_Y 0.1318252536L
+#define BENCH_SCALE 0.01L
+#define BENCH_RUNS 3
+#define BENCH_REFERENCE_X -0.1L
+#define BENCH_REFERENCE_Y 0.1L
+
+static double bench_now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv)
+{
+    int thread_count = pool_default_thread_count();
+    int iterations = 2000;
+    int size = 512;
+    double bla_epsilon = 0.0;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            thread_count = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+            iterations = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            size = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc) {
+            bla_epsilon = atof(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [-j threads] [-i iterations] [-s size] [-e bla-epsilon]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    ThreadPool *pool = pool_create(thread_count);
+    const EscapeKernels *kernels = kernel_select();
+    printf("INFO: %dx%d samples, %d iterations, %d threads, %s kernel\n",
+            size, size, iterations, pool_thread_count(pool), kernels->name);
+
+    int *iters = malloc(size * size * sizeof(*iters));
+    if (iters == NULL) {
+        fprintf(stderr, "ERROR: Could not allocate the sample buffer\n");
+        return EXIT_FAILURE;
+    }
+
+    for (int p = PRECISION_FLOAT; p < PRECISION_COUNT; ++p) {
+        RenderParams params = {
+            .camera = { BENCH_CAMERA_X, BENCH_CAMERA_Y },
+            .scale = { BENCH_SCALE, BENCH_SCALE },
+            .width = size,
+            .height = size,
+            .pixel_width = 1,
+            .pixel_height = 1,
+            .iterations = iterations,
+            .engine = ENGINE_PIXEL,
+            .precision = p,
+            .bla_epsilon = bla_epsilon,
+        };
+
+        // Best of a few runs
+        double best = -1.0;
+        for (int run = 0; run < BENCH_RUNS; ++run) {
+            double start = bench_now();
+            render_iterations(pool, kernels, &params, iters, NULL);
+            double elapsed = bench_now() - start;
+            if (best < 0.0 || elapsed < best) best = elapsed;
+        }
+
+        // Iterations of the samples that escaped, the others may have been
+        // cut short by the periodicity check
+        long escaped = 0;
+        long steps = 0;
+        for (int i = 0; i < size*size; ++i) {
+            if (iters[i] < iterations) {
+                ++escaped;
+                steps += iters[i] + 1;
+            }
+        }
+
+        printf("%-14s %8.1fms %10.2f Msamples/s %10.2f Giterations/s (%ld escaped)\n",
+                render_precision_name(p), best * 1e3, size*size / best * 1e-6, steps / best * 1e-9, escaped);
+    }
+
+    MpVector2 c;
+    mp_from_long_double(&c.x, BENCH_REFERENCE_X);
+    mp_from_long_double(&c.y, BENCH_REFERENCE_Y);
+    ReferenceOrbit reference = { 0 };
+    for (int limbs = 2; limbs <= MP_MAX_LIMBS; limbs *= 2) {
+        double start = bench_now();
+        reference_compute_fixed(&reference, &c, limbs, iterations);
+        double fixed = bench_now() - start;
+        printf("reference %5d bits %10.3f Miterations/s fixed point", 64*(limbs - 1), iterations / fixed * 1e-6);
+#ifdef HAVE_MPFR
+        start = bench_now();
+        reference_compute_mpfr(&reference, &c, limbs, iterations);
+        double mpfr = bench_now() - start;
+        printf(", %10.3f Miterations/s MPFR", iterations / mpfr * 1e-6);
+#endif
+        printf("\n");
+    }
+    reference_free(&reference);
+
+    free(iters);
+    pool_destroy(pool);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,291 @@
+#include "kernel.h"
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __x86_64__
+#include <cpuid.h>
+#endif
+
+#define KERNEL_NAME escape_scalar_float
+#define KERNEL_RESUME_NAME resume_scalar_float
+#define KERNEL_T float
+#define KERNEL_ABS fabsf
+#define KERNEL_EPSILON PERIOD_EPSILON_FLOAT
+#include "kernel_scalar.h"
+#undef KERNEL_NAME
+#undef KERNEL_RESUME_NAME
+#undef KERNEL_T
+#undef KERNEL_ABS
+#undef KERNEL_EPSILON
+
+#define KERNEL_NAME escape_scalar_double
+#define KERNEL_RESUME_NAME resume_scalar_double
+#define KERNEL_T double
+#define KERNEL_ABS fabs
+#define KERNEL_EPSILON PERIOD_EPSILON_DOUBLE
+#include "kernel_scalar.h"
+#undef KERNEL_NAME
+#undef KERNEL_RESUME_NAME
+#undef KERNEL_T
+#undef KERNEL_ABS
+#undef KERNEL_EPSILON
+
+#define KERNEL_NAME escape_scalar_long_double
+#define KERNEL_T long double
+#define KERNEL_ABS fabsl
+#define KERNEL_EPSILON PERIOD_EPSILON_LONG_DOUBLE
+#include "kernel_scalar.h"
+#undef KERNEL_NAME
+#undef KERNEL_T
+#undef KERNEL_ABS
+#undef KERNEL_EPSILON
+
+// Double-double only has this one scalar instance
+void escape_scalar_double_double(const DoubleDouble *cr, const DoubleDouble *ci, int count, int iterations,
+        int *out, int *out_mirror, float *out_fraction, float *out_fraction_mirror)
+{
+    if (iterations < 0) iterations = 0;
+
+    for (int p = 0; p < count; ++p) {
+        DoubleDouble z_real = cr[p];
+        DoubleDouble z_imag = ci[p];
+        DoubleDouble c_real = z_real;
+        DoubleDouble c_imag = z_imag;
+
+        DoubleDouble saved_real = z_real;
+        DoubleDouble saved_imag = z_imag;
+        int save_interval = PERIOD_FIRST_INTERVAL;
+        int save_at = PERIOD_FIRST_INTERVAL;
+
+        int escaped = -1;
+        int escaped_mirror = (out_mirror != NULL) ? -1 : 0;
+        float fraction = 0.0f;
+        float fraction_mirror = 0.0f;
+
+        int i;
+        for (i = 0; i < iterations; ++i) {
+            DoubleDouble z_real2 = dd_sqr(z_real);
+            DoubleDouble z_imag2 = dd_sqr(z_imag);
+            DoubleDouble z_cross = dd_mul(z_real, z_imag);
+
+            z_real = dd_add(dd_sub(z_real2, z_imag2), c_real);
+            z_imag = dd_add((DoubleDouble){ z_cross.hi + z_cross.hi, z_cross.lo + z_cross.lo }, c_imag);
+
+            if (escaped < 0 && fabs(z_real.hi + z_imag.hi) > MANDEL_INFINITY) {
+                escaped = i;
+                fraction = escape_fraction(c_real.hi, c_imag.hi, z_real.hi, z_imag.hi);
+            }
+            if (escaped_mirror < 0 && fabs(z_real.hi - z_imag.hi) > MANDEL_INFINITY) {
+                escaped_mirror = i;
+                fraction_mirror = escape_fraction(c_real.hi, c_imag.hi, z_real.hi, z_imag.hi);
+            }
+            if (escaped >= 0 && escaped_mirror >= 0) {
+                break;
+            }
+
+            double distance = fabs((z_real.hi - saved_real.hi) + (z_real.lo - saved_real.lo))
+                + fabs((z_imag.hi - saved_imag.hi) + (z_imag.lo - saved_imag.lo));
+            if (distance < PERIOD_EPSILON_DOUBLE_DOUBLE) {
+                break;
+            }
+
+            if (i + 1 == save_at) {
+                saved_real = z_real;
+                saved_imag = z_imag;
+                if (save_interval*2 <= PERIOD_MAX_INTERVAL) save_interval *= 2;
+                save_at += save_interval;
+            }
+        }
+
+        out[p] = (escaped >= 0) ? escaped : iterations;
+        if (out_mirror != NULL) {
+            out_mirror[p] = (escaped_mirror >= 0) ? escaped_mirror : iterations;
+        }
+        if (out_fraction != NULL) out_fraction[p] = fraction;
+        if (out_fraction_mirror != NULL && out_mirror != NULL) out_fraction_mirror[p] = fraction_mirror;
+    }
+}
+
+// An orbit past the escape radius soon outgrows the integer bits. Until one
+// of the two orbits escapes, |Re(z) + Im(z)| and |Re(z) - Im(z)| are both
+// within 16, so |Re(z)| and |Im(z)| are as well. After that the other one
+// is known to escape on the next step once |Re(z)| or |Im(z)| reaches
+// FIXED_ESCAPE_BOUND: with s = x + y, |s| <= 16 and |x| >= 48, the next sum
+// is -2x^2 + 4xs - s^2 + cr + ci, far past 16. Below the bound, and with c
+// within FIXED_COORDINATE_LIMIT, every intermediate stays under 2^14.
+#define FIXED_ESCAPE_BOUND 64
+
+void escape_scalar_fixed(const Fixed128 *cr, const Fixed128 *ci, int count, int iterations,
+        int *out, int *out_mirror, float *out_fraction, float *out_fraction_mirror)
+{
+    const Fixed128 infinity = (Fixed128)MANDEL_INFINITY * FIXED_ONE;
+    const Fixed128 bound = (Fixed128)FIXED_ESCAPE_BOUND * FIXED_ONE;
+
+    if (iterations < 0) iterations = 0;
+
+    for (int p = 0; p < count; ++p) {
+        Fixed128 z_real = cr[p];
+        Fixed128 z_imag = ci[p];
+        Fixed128 c_real = z_real;
+        Fixed128 c_imag = z_imag;
+
+        Fixed128 saved_real = z_real;
+        Fixed128 saved_imag = z_imag;
+        int save_interval = PERIOD_FIRST_INTERVAL;
+        int save_at = PERIOD_FIRST_INTERVAL;
+
+        int escaped = -1;
+        int escaped_mirror = (out_mirror != NULL) ? -1 : 0;
+        float fraction = 0.0f;
+        float fraction_mirror = 0.0f;
+
+        int i;
+        for (i = 0; i < iterations; ++i) {
+            Fixed128 z_real2 = fx_sqr(z_real);
+            Fixed128 z_imag2 = fx_sqr(z_imag);
+            Fixed128 z_cross = fx_mul(z_real, z_imag);
+
+            z_real = z_real2 - z_imag2 + c_real;
+            z_imag = 2*z_cross + c_imag;
+
+            if (escaped < 0 && fx_abs(z_real + z_imag) > (unsigned __int128)infinity) {
+                escaped = i;
+                fraction = escape_fraction(fx_to_double(c_real), fx_to_double(c_imag),
+                        fx_to_double(z_real), fx_to_double(z_imag));
+            }
+            if (escaped_mirror < 0 && fx_abs(z_real - z_imag) > (unsigned __int128)infinity) {
+                escaped_mirror = i;
+                fraction_mirror = escape_fraction(fx_to_double(c_real), fx_to_double(c_imag),
+                        fx_to_double(z_real), fx_to_double(z_imag));
+            }
+            if (escaped >= 0 && escaped_mirror >= 0) {
+                break;
+            }
+            if (fx_abs(z_real) >= (unsigned __int128)bound || fx_abs(z_imag) >= (unsigned __int128)bound) {
+                // The fraction from z is that of the next count, one step on
+                if (i + 1 < iterations) {
+                    float next = escape_fraction(fx_to_double(c_real), fx_to_double(c_imag),
+                            fx_to_double(z_real), fx_to_double(z_imag)) - 1.0f;
+                    if (escaped < 0) {
+                        escaped = i + 1;
+                        fraction = next;
+                    }
+                    if (escaped_mirror < 0) {
+                        escaped_mirror = i + 1;
+                        fraction_mirror = next;
+                    }
+                }
+                break;
+            }
+
+            if (fx_abs(z_real - saved_real) + fx_abs(z_imag - saved_imag) < (unsigned __int128)PERIOD_EPSILON_FIXED) {
+                break;
+            }
+
+            if (i + 1 == save_at) {
+                saved_real = z_real;
+                saved_imag = z_imag;
+                if (save_interval*2 <= PERIOD_MAX_INTERVAL) save_interval *= 2;
+                save_at += save_interval;
+            }
+        }
+
+        out[p] = (escaped >= 0) ? escaped : iterations;
+        if (out_mirror != NULL) {
+            out_mirror[p] = (escaped_mirror >= 0) ? escaped_mirror : iterations;
+        }
+        if (out_fraction != NULL) out_fraction[p] = fraction;
+        if (out_fraction_mirror != NULL && out_mirror != NULL) out_fraction_mirror[p] = fraction_mirror;
+    }
+}
+
+typedef enum {
+    ISA_SCALAR = 0,
+    ISA_SSE2,
+    ISA_AVX2,
+    ISA_AVX512,
+    ISA_COUNT,
+} KernelIsa;
+
+static const EscapeKernels kernels[ISA_COUNT] = {
+    [ISA_SCALAR] = { "scalar", escape_scalar_float, escape_scalar_double, escape_scalar_long_double,
+                     escape_scalar_double_double, resume_scalar_float, resume_scalar_double },
+#ifdef __x86_64__
+    [ISA_SSE2]   = { "sse2",   escape_sse2_float,   escape_sse2_double,   escape_scalar_long_double,
+                     escape_sse2_double_double, resume_sse2_float, resume_sse2_double },
+    [ISA_AVX2]   = { "avx2",   escape_avx2_float,   escape_avx2_double,   escape_scalar_long_double,
+                     escape_avx2_double_double, resume_avx2_float, resume_avx2_double },
+    [ISA_AVX512] = { "avx512", escape_avx512_float, escape_avx512_double, escape_scalar_long_double,
+                     escape_avx512_double_double, resume_avx512_float, resume_avx512_double },
+#endif
+};
+
+#ifdef __x86_64__
+static uint64_t read_xcr0(void)
+{
+    uint32_t lo, hi;
+    __asm__ volatile ("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return ((uint64_t)hi << 32) | lo;
+}
+#endif
+
+// Best ISA that both the CPU and the OS (saved register state) support
+static KernelIsa detect_isa(void)
+{
+    KernelIsa best = ISA_SCALAR;
+
+#ifdef __x86_64__
+    unsigned eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return best;
+    if (edx & bit_SSE2) best = ISA_SSE2;
+
+    // The AVX2 kernels use FMA as well
+    if (!(ecx & bit_OSXSAVE) || !(ecx & bit_AVX) || !(ecx & bit_FMA)) return best;
+    uint64_t xcr0 = read_xcr0();
+    if ((xcr0 & 0x06) != 0x06) return best; // XMM and YMM state
+
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) return best;
+    if (ebx & bit_AVX2) best = ISA_AVX2;
+    if ((ebx & bit_AVX512F) && (xcr0 & 0xe6) == 0xe6) best = ISA_AVX512; // + opmask and ZMM state
+#endif
+
+    return best;
+}
+
+const EscapeKernels *kernel_select(void)
+{
+    static const EscapeKernels *selected = NULL;
+
+    if (selected == NULL) {
+        KernelIsa best = detect_isa();
+        KernelIsa isa = best;
+
+        const char *requested = getenv("MANDELBROT_KERNEL");
+        if (requested != NULL && *requested != '\0') {
+            KernelIsa found = ISA_COUNT;
+            for (int i = 0; i < ISA_COUNT; ++i) {
+                if (kernels[i].name != NULL && strcmp(kernels[i].name, requested) == 0) {
+                    found = i;
+                }
+            }
+
+            if (found == ISA_COUNT) {
+                fprintf(stderr, "WARNING: Unknown kernel '%s', using %s\n", requested, kernels[best].name);
+            } else if (found > best) {
+                fprintf(stderr, "WARNING: This CPU does not support the %s kernel, using %s\n",
+                        requested, kernels[best].name);
+            } else {
+                isa = found;
+            }
+        }
+
+        selected = &kernels[isa];
+    }
+
+    return selected;
+}
@@ -0,0 +1,175 @@
+#ifndef KERNEL_H
+#define KERNEL_H
+
+#include <float.h>
+#include <math.h>
+#include <stdbool.h>
+
+#include "kernel_dd.h"
+#include "kernel_fx.h"
+
+#define MANDEL_INFINITY 16.0
+
+// Periodicity checking: z is remembered after PERIOD_FIRST_INTERVAL steps and
+// then after intervals that double each time, up to PERIOD_MAX_INTERVAL. A
+// pixel whose z comes back within the epsilon of its type to a remembered
+// value is on a cycle and will never escape.
+#define PERIOD_FIRST_INTERVAL 8
+#define PERIOD_MAX_INTERVAL (1 << 20)
+#define PERIOD_EPSILON_FLOAT (8*FLT_EPSILON)
+#define PERIOD_EPSILON_DOUBLE (8*DBL_EPSILON)
+#define PERIOD_EPSILON_LONG_DOUBLE (8*LDBL_EPSILON)
+#define PERIOD_EPSILON_DOUBLE_DOUBLE (8*DBL_EPSILON*DBL_EPSILON)
+#define PERIOD_EPSILON_FIXED ((Fixed128)8) // In units of the last bit
+
+// Escape-time kernels. Every kernel computes, for `count` points
+// c = cr[i] + ci[i]*i, the number of iterations before |Re(z) + Im(z)|
+// exceeded MANDEL_INFINITY, or `iterations` if it never did or its orbit was
+// found to be periodic. All kernels return exactly the same counts as the
+// scalar one.
+//
+// When `out_mirror` is not NULL it receives the counts of the conjugate
+// points cr[i] - ci[i]*i. Their orbits are the exact mirror images of the
+// computed ones, so both come out of a single orbit.
+//
+// The float, double and long double kernels also take `out_zr` and
+// `out_zi`, which may be NULL. For the points whose orbit (or conjugate
+// orbit) reached the iteration limit they receive z after `iterations`
+// steps, and NaN for orbits found to be periodic, which never escape. The
+// other entries are left as they are. The resume kernels carry such an
+// orbit on when the limit is raised.
+//
+// Every kernel also takes `out_fraction` and `out_fraction_mirror`, which
+// may be NULL (the mirror one is only used along with `out_mirror`). They
+// receive escape_fraction() of z at the escape of every point that escaped,
+// and 0 for the others, so count + fraction is a smooth count. It is not
+// confined to [count, count + 1).
+
+typedef void (*EscapeKernelFloat)(const float *cr, const float *ci, int count, int iterations,
+        int *out, int *out_mirror, float *out_zr, float *out_zi, float *out_fraction, float *out_fraction_mirror);
+typedef void (*EscapeKernelDouble)(const double *cr, const double *ci, int count, int iterations,
+        int *out, int *out_mirror, double *out_zr, double *out_zi, float *out_fraction, float *out_fraction_mirror);
+typedef void (*EscapeKernelLongDouble)(const long double *cr, const long double *ci, int count, int iterations,
+        int *out, int *out_mirror, long double *out_zr, long double *out_zi,
+        float *out_fraction, float *out_fraction_mirror);
+// Carry on orbits that stopped at the limit `from`, see resume_scalar_float()
+typedef void (*EscapeResumeFloat)(const float *cr, const float *ci, float *zr, float *zi, int count, int from,
+        int iterations, int *out, int *out_mirror, float *out_fraction, float *out_fraction_mirror);
+typedef void (*EscapeResumeDouble)(const double *cr, const double *ci, double *zr, double *zi, int count, int from,
+        int iterations, int *out, int *out_mirror, float *out_fraction, float *out_fraction_mirror);
+// Double-double kernels test for escape on the high parts only
+typedef void (*EscapeKernelDoubleDouble)(const DoubleDouble *cr, const DoubleDouble *ci, int count, int iterations,
+        int *out, int *out_mirror, float *out_fraction, float *out_fraction_mirror);
+
+// There is no vector unit for long double, every ISA uses the scalar kernel
+typedef struct {
+    const char *name;
+    EscapeKernelFloat escape_float;
+    EscapeKernelDouble escape_double;
+    EscapeKernelLongDouble escape_long_double;
+    EscapeKernelDoubleDouble escape_double_double;
+    EscapeResumeFloat resume_float;
+    EscapeResumeDouble resume_double;
+} EscapeKernels;
+
+// Picks the fastest kernels the CPU supports, once. Setting the
+// MANDELBROT_KERNEL environment variable to "scalar", "sse2", "avx2" or
+// "avx512" overrides the choice as long as the CPU supports it.
+const EscapeKernels *kernel_select(void);
+
+// Offset of the smooth count of an orbit of c from its count, from z right
+// after the escape, for smooth colouring. The count test is not on |z|, so
+// |z| there can be anywhere from about 11.3 up. The orbit is carried on in
+// double until |z| passes SMOOTH_RADIUS, and the steps that took are counted
+// back in: k + 1 - log2(log|z_k| / log R) with R = MANDEL_INFINITY. That is
+// continuous in c across counts, mostly within [0, 1) but not bounded by it.
+#define SMOOTH_RADIUS 1e10
+#define SMOOTH_MAX_STEPS 64 // Orbits double log|z| every step past the escape
+
+static inline float escape_fraction(double cr, double ci, double zr, double zi)
+{
+    double norm = zr*zr + zi*zi;
+    int k = 0;
+
+    while (norm <= SMOOTH_RADIUS*SMOOTH_RADIUS && k < SMOOTH_MAX_STEPS) {
+        double z_real = zr*zr - zi*zi + cr;
+        zi = 2*zr*zi + ci;
+        zr = z_real;
+        norm = zr*zr + zi*zi;
+        ++k;
+    }
+    if (!isfinite(norm)) return 0.0f; // Came in past what a double holds
+
+    return (float)(k + 1 - log2(log(norm) / (2.0*log(MANDEL_INFINITY))));
+}
+
+// Closed-form test for the main cardioid and the period-2 bulb. Points
+// inside them never escape, so they can be marked interior without
+// iterating.
+static inline bool inside_main_bulbs(double cr, double ci)
+{
+    double ci2 = ci*ci;
+
+    double x = cr - 0.25;
+    double q = x*x + ci2;
+    if (q*(q + x) <= 0.25*ci2) return true;
+
+    double y = cr + 1.0;
+    return y*y + ci2 <= 0.0625;
+}
+
+void escape_scalar_float(const float *cr, const float *ci, int count, int iterations, int *out, int *out_mirror,
+        float *out_zr, float *out_zi, float *out_fraction, float *out_fraction_mirror);
+void escape_scalar_double(const double *cr, const double *ci, int count, int iterations, int *out, int *out_mirror,
+        double *out_zr, double *out_zi, float *out_fraction, float *out_fraction_mirror);
+void escape_scalar_long_double(const long double *cr, const long double *ci, int count, int iterations, int *out, int *out_mirror,
+        long double *out_zr, long double *out_zi, float *out_fraction, float *out_fraction_mirror);
+void escape_scalar_double_double(const DoubleDouble *cr, const DoubleDouble *ci, int count, int iterations, int *out, int *out_mirror,
+        float *out_fraction, float *out_fraction_mirror);
+// Carries on the orbits of the points that stopped at the limit `from`, with
+// z in `zr` and `zi` as the kernels above left it, up to `iterations`.
+// Counts in `out` and `out_mirror` (which may be NULL) that equal `from`
+// are the orbits still going and are updated, the others are left as they
+// are, and so are their fractions. `zr` and `zi` are updated the same way
+// as `out_zr` and `out_zi` above. The counts are the same as iterating from
+// the start, only the periodicity checkpoint starts over from z at `from`.
+void resume_scalar_float(const float *cr, const float *ci, float *zr, float *zi, int count, int from, int iterations,
+        int *out, int *out_mirror, float *out_fraction, float *out_fraction_mirror);
+void resume_scalar_double(const double *cr, const double *ci, double *zr, double *zi, int count, int from, int iterations,
+        int *out, int *out_mirror, float *out_fraction, float *out_fraction_mirror);
+// Fixed point only has a scalar kernel, which every ISA uses. Coordinates
+// have to be within FIXED_COORDINATE_LIMIT.
+void escape_scalar_fixed(const Fixed128 *cr, const Fixed128 *ci, int count, int iterations, int *out, int *out_mirror,
+        float *out_fraction, float *out_fraction_mirror);
+void escape_sse2_float(const float *cr, const float *ci, int count, int iterations, int *out, int *out_mirror,
+        float *out_zr, float *out_zi, float *out_fraction, float *out_fraction_mirror);
+void escape_sse2_double(const double *cr, const double *ci, int count, int iterations, int *out, int *out_mirror,
+        double *out_zr, double *out_zi, float *out_fraction, float *out_fraction_mirror);
+void escape_sse2_double_double(const DoubleDouble *cr, const DoubleDouble *ci, int count, int iterations, int *out, int *out_mirror,
+        float *out_fraction, float *out_fraction_mirror);
+void resume_sse2_float(const float *cr, const float *ci, float *zr, float *zi, int count, int from,
+        int iterations, int *out, int *out_mirror, float *out_fraction, float *out_fraction_mirror);
+void resume_sse2_double(const double *cr, const double *ci, double *zr, double *zi, int count, int from,
+        int iterations, int *out, int *out_mirror, float *out_fraction, float *out_fraction_mirror);
+void escape_avx2_float(const float *cr, const float *ci, int count, int iterations, int *out, int *out_mirror,
+        float *out_zr, float *out_zi, float *out_fraction, float *out_fraction_mirror);
+void escape_avx2_double(const double *cr, const double *ci, int count, int iterations, int *out, int *out_mirror,
+        double *out_zr, double *out_zi, float *out_fraction, float *out_fraction_mirror);
+void escape_avx2_double_double(const DoubleDouble *cr, const DoubleDouble *ci, int count, int iterations, int *out, int *out_mirror,
+        float *out_fraction, float *out_fraction_mirror);
+void resume_avx2_float(const float *cr, const float *ci, float *zr, float *zi, int count, int from,
+        int iterations, int *out, int *out_mirror, float *out_fraction, float *out_fraction_mirror);
+void resume_avx2_double(const double *cr, const double *ci, double *zr, double *zi, int count, int from,
+        int iterations, int *out, int *out_mirror, float *out_fraction, float *out_fraction_mirror);
+void escape_avx512_float(const float *cr, const float *ci, int count, int iterations, int *out, int *out_mirror,
+        float *out_zr, float *out_zi, float *out_fraction, float *out_fraction_mirror);
+void escape_avx512_double(const double *cr, const double *ci, int count, int iterations, int *out, int *out_mirror,
+        double *out_zr, double *out_zi, float *out_fraction, float *out_fraction_mirror);
+void escape_avx512_double_double(const DoubleDouble *cr, const DoubleDouble *ci, int count, int iterations, int *out, int *out_mirror,
+        float *out_fraction, float *out_fraction_mirror);
+void resume_avx512_float(const float *cr, const float *ci, float *zr, float *zi, int count, int from,
+        int iterations, int *out, int *out_mirror, float *out_fraction, float *out_fraction_mirror);
+void resume_avx512_double(const double *cr, const double *ci, double *zr, double *zi, int count, int from,
+        int iterations, int *out, int *out_mirror, float *out_fraction, float *out_fraction_mirror);
+
+#endif // KERNEL_H
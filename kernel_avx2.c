@@ -0,0 +1,86 @@
+// Built with -mavx2 -mfma, only called when the CPU supports both
+#include "kernel.h"
+
+#include <immintrin.h>
+
+static inline __m256 abs_ps(__m256 v) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), v); }
+static inline __m256 gt_ps(__m256 a, __m256 b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+static inline __m256 lt_ps(__m256 a, __m256 b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+static inline __m256 le_ps(__m256 a, __m256 b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+static inline __m256 select_ps(__m256 m, __m256 a, __m256 b) { return _mm256_blendv_ps(b, a, m); }
+
+static inline __m256d abs_pd(__m256d v) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), v); }
+static inline __m256d gt_pd(__m256d a, __m256d b) { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+static inline __m256d lt_pd(__m256d a, __m256d b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+static inline __m256d le_pd(__m256d a, __m256d b) { return _mm256_cmp_pd(a, b, _CMP_LE_OQ); }
+static inline __m256d select_pd(__m256d m, __m256d a, __m256d b) { return _mm256_blendv_pd(b, a, m); }
+
+#define KERNEL_NAME escape_avx2_float
+#define KERNEL_RESUME_NAME resume_avx2_float
+#define KERNEL_T float
+#define KERNEL_V __m256
+#define KERNEL_M __m256
+#define KERNEL_LANES 8
+#define KERNEL_EPSILON PERIOD_EPSILON_FLOAT
+#define V_SET1 _mm256_set1_ps
+#define V_LOAD _mm256_load_ps
+#define V_STORE _mm256_store_ps
+#define V_ADD _mm256_add_ps
+#define V_SUB _mm256_sub_ps
+#define V_MUL _mm256_mul_ps
+#define V_ABS abs_ps
+#define V_GT gt_ps
+#define V_LT lt_ps
+#define V_LE le_ps
+#define V_BITS _mm256_movemask_ps
+#define V_SELECT select_ps
+#include "kernel_simd.h"
+#undef KERNEL_NAME
+#undef KERNEL_RESUME_NAME
+#undef KERNEL_T
+#undef KERNEL_V
+#undef KERNEL_M
+#undef KERNEL_LANES
+#undef KERNEL_EPSILON
+#undef V_SET1
+#undef V_LOAD
+#undef V_STORE
+#undef V_ADD
+#undef V_SUB
+#undef V_MUL
+#undef V_ABS
+#undef V_GT
+#undef V_LT
+#undef V_LE
+#undef V_BITS
+#undef V_SELECT
+
+#define KERNEL_NAME escape_avx2_double
+#define KERNEL_RESUME_NAME resume_avx2_double
+#define KERNEL_T double
+#define KERNEL_V __m256d
+#define KERNEL_M __m256d
+#define KERNEL_LANES 4
+#define KERNEL_EPSILON PERIOD_EPSILON_DOUBLE
+#define V_SET1 _mm256_set1_pd
+#define V_LOAD _mm256_load_pd
+#define V_STORE _mm256_store_pd
+#define V_ADD _mm256_add_pd
+#define V_SUB _mm256_sub_pd
+#define V_MUL _mm256_mul_pd
+#define V_ABS abs_pd
+#define V_GT gt_pd
+#define V_LT lt_pd
+#define V_LE le_pd
+#define V_BITS _mm256_movemask_pd
+#define V_SELECT select_pd
+#include "kernel_simd.h"
+#undef KERNEL_RESUME_NAME
+
+// Double-double shares the double precision operations above
+#undef KERNEL_NAME
+#undef KERNEL_EPSILON
+#define KERNEL_NAME escape_avx2_double_double
+#define KERNEL_EPSILON PERIOD_EPSILON_DOUBLE_DOUBLE
+#define V_PROD_ERROR _mm256_fmsub_pd
+#include "kernel_dd_simd.h"
@@ -0,0 +1,84 @@
+// Built with -mavx512f, only called when the CPU supports it
+#include "kernel.h"
+
+#include <immintrin.h>
+
+static inline __mmask16 gt_ps(__m512 a, __m512 b) { return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ); }
+static inline __mmask16 lt_ps(__m512 a, __m512 b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+static inline __mmask16 le_ps(__m512 a, __m512 b) { return _mm512_cmp_ps_mask(a, b, _CMP_LE_OQ); }
+static inline __m512 select_ps(__mmask16 m, __m512 a, __m512 b) { return _mm512_mask_blend_ps(m, b, a); }
+
+static inline __mmask8 gt_pd(__m512d a, __m512d b) { return _mm512_cmp_pd_mask(a, b, _CMP_GT_OQ); }
+static inline __mmask8 lt_pd(__m512d a, __m512d b) { return _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ); }
+static inline __mmask8 le_pd(__m512d a, __m512d b) { return _mm512_cmp_pd_mask(a, b, _CMP_LE_OQ); }
+static inline __m512d select_pd(__mmask8 m, __m512d a, __m512d b) { return _mm512_mask_blend_pd(m, b, a); }
+
+#define KERNEL_NAME escape_avx512_float
+#define KERNEL_RESUME_NAME resume_avx512_float
+#define KERNEL_T float
+#define KERNEL_V __m512
+#define KERNEL_M __mmask16
+#define KERNEL_LANES 16
+#define KERNEL_EPSILON PERIOD_EPSILON_FLOAT
+#define V_SET1 _mm512_set1_ps
+#define V_LOAD _mm512_load_ps
+#define V_STORE _mm512_store_ps
+#define V_ADD _mm512_add_ps
+#define V_SUB _mm512_sub_ps
+#define V_MUL _mm512_mul_ps
+#define V_ABS _mm512_abs_ps
+#define V_GT gt_ps
+#define V_LT lt_ps
+#define V_LE le_ps
+#define V_BITS (unsigned)
+#define V_SELECT select_ps
+#include "kernel_simd.h"
+#undef KERNEL_NAME
+#undef KERNEL_RESUME_NAME
+#undef KERNEL_T
+#undef KERNEL_V
+#undef KERNEL_M
+#undef KERNEL_LANES
+#undef KERNEL_EPSILON
+#undef V_SET1
+#undef V_LOAD
+#undef V_STORE
+#undef V_ADD
+#undef V_SUB
+#undef V_MUL
+#undef V_ABS
+#undef V_GT
+#undef V_LT
+#undef V_LE
+#undef V_BITS
+#undef V_SELECT
+
+#define KERNEL_NAME escape_avx512_double
+#define KERNEL_RESUME_NAME resume_avx512_double
+#define KERNEL_T double
+#define KERNEL_V __m512d
+#define KERNEL_M __mmask8
+#define KERNEL_LANES 8
+#define KERNEL_EPSILON PERIOD_EPSILON_DOUBLE
+#define V_SET1 _mm512_set1_pd
+#define V_LOAD _mm512_load_pd
+#define V_STORE _mm512_store_pd
+#define V_ADD _mm512_add_pd
+#define V_SUB _mm512_sub_pd
+#define V_MUL _mm512_mul_pd
+#define V_ABS _mm512_abs_pd
+#define V_GT gt_pd
+#define V_LT lt_pd
+#define V_LE le_pd
+#define V_BITS (unsigned)
+#define V_SELECT select_pd
+#include "kernel_simd.h"
+#undef KERNEL_RESUME_NAME
+
+// Double-double shares the double precision operations above
+#undef KERNEL_NAME
+#undef KERNEL_EPSILON
+#define KERNEL_NAME escape_avx512_double_double
+#define KERNEL_EPSILON PERIOD_EPSILON_DOUBLE_DOUBLE
+#define V_PROD_ERROR _mm512_fmsub_pd
+#include "kernel_dd_simd.h"
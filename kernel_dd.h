@@ -0,0 +1,88 @@
+#ifndef KERNEL_DD_H
+#define KERNEL_DD_H
+
+#include <math.h>
+
+// Double-double arithmetic. A value is the unevaluated sum hi + lo of two
+// doubles with |lo| <= ulp(hi)/2, which carries about 106 bits of mantissa.
+// The operations are built from error-free transformations (two-sum and the
+// FMA two-product). The SIMD kernels follow them operation by operation, so
+// every kernel ends up with the same bits.
+
+typedef struct {
+    double hi;
+    double lo;
+} DoubleDouble;
+
+static inline DoubleDouble dd_two_sum(double a, double b)
+{
+    double s = a + b;
+    double bb = s - a;
+    double e = (a - (s - bb)) + (b - bb);
+
+    return (DoubleDouble){ s, e };
+}
+
+// Only exact when |a| >= |b|
+static inline DoubleDouble dd_quick_two_sum(double a, double b)
+{
+    double s = a + b;
+    double e = b - (s - a);
+
+    return (DoubleDouble){ s, e };
+}
+
+static inline DoubleDouble dd_two_prod(double a, double b)
+{
+    double p = a * b;
+    double e = fma(a, b, -p);
+
+    return (DoubleDouble){ p, e };
+}
+
+static inline DoubleDouble dd_from_long_double(long double value)
+{
+    double hi = (double)value;
+    double lo = (double)(value - hi);
+
+    return (DoubleDouble){ hi, lo };
+}
+
+static inline DoubleDouble dd_neg(DoubleDouble a)
+{
+    return (DoubleDouble){ -a.hi, -a.lo };
+}
+
+// The error is bounded by the magnitude of the operands rather than the
+// result, which is all the iteration needs and half the cost of the exact
+// variant
+static inline DoubleDouble dd_add(DoubleDouble a, DoubleDouble b)
+{
+    DoubleDouble s = dd_two_sum(a.hi, b.hi);
+    s.lo += a.lo + b.lo;
+
+    return dd_quick_two_sum(s.hi, s.lo);
+}
+
+static inline DoubleDouble dd_sub(DoubleDouble a, DoubleDouble b)
+{
+    return dd_add(a, dd_neg(b));
+}
+
+static inline DoubleDouble dd_mul(DoubleDouble a, DoubleDouble b)
+{
+    DoubleDouble p = dd_two_prod(a.hi, b.hi);
+    p.lo += a.hi*b.lo + a.lo*b.hi;
+
+    return dd_quick_two_sum(p.hi, p.lo);
+}
+
+static inline DoubleDouble dd_sqr(DoubleDouble a)
+{
+    DoubleDouble p = dd_two_prod(a.hi, a.hi);
+    p.lo += (a.hi + a.hi)*a.lo;
+
+    return dd_quick_two_sum(p.hi, p.lo);
+}
+
+#endif // KERNEL_DD_H
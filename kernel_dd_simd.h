@@ -0,0 +1,280 @@
+// Generic SIMD double-double escape-time kernel, included once per ISA.
+//
+// The including file defines the double precision operations used by
+// kernel_simd.h, plus:
+//   KERNEL_NAME            name of the generated function
+//   KERNEL_EPSILON         periodicity tolerance
+//   V_PROD_ERROR(a, b, p)  exact error a*b - p of the rounded product p
+//
+// Lanes are refilled the same way as in kernel_simd.h. Every double-double
+// operation mirrors the scalar one in kernel_dd.h, so the iteration counts
+// are identical to escape_scalar_double_double(). Fractions are taken from
+// the high parts, as the escape test is.
+
+#include <limits.h>
+#include <stdbool.h>
+
+#define KERNEL_CONCAT_(a, b) a##b
+#define KERNEL_CONCAT(a, b) KERNEL_CONCAT_(a, b)
+#define KERNEL_BODY KERNEL_CONCAT(KERNEL_NAME, _body)
+
+typedef struct {
+    KERNEL_V hi;
+    KERNEL_V lo;
+} VectorDD;
+
+static inline __attribute__((always_inline)) VectorDD vdd_two_sum(KERNEL_V a, KERNEL_V b)
+{
+    KERNEL_V s = V_ADD(a, b);
+    KERNEL_V bb = V_SUB(s, a);
+    KERNEL_V e = V_ADD(V_SUB(a, V_SUB(s, bb)), V_SUB(b, bb));
+
+    return (VectorDD){ s, e };
+}
+
+static inline __attribute__((always_inline)) VectorDD vdd_quick_two_sum(KERNEL_V a, KERNEL_V b)
+{
+    KERNEL_V s = V_ADD(a, b);
+    KERNEL_V e = V_SUB(b, V_SUB(s, a));
+
+    return (VectorDD){ s, e };
+}
+
+static inline __attribute__((always_inline)) VectorDD vdd_add(VectorDD a, VectorDD b)
+{
+    VectorDD s = vdd_two_sum(a.hi, b.hi);
+    s.lo = V_ADD(s.lo, V_ADD(a.lo, b.lo));
+
+    return vdd_quick_two_sum(s.hi, s.lo);
+}
+
+static inline __attribute__((always_inline)) VectorDD vdd_mul(VectorDD a, VectorDD b)
+{
+    KERNEL_V p = V_MUL(a.hi, b.hi);
+    KERNEL_V e = V_PROD_ERROR(a.hi, b.hi, p);
+    e = V_ADD(e, V_ADD(V_MUL(a.hi, b.lo), V_MUL(a.lo, b.hi)));
+
+    return vdd_quick_two_sum(p, e);
+}
+
+static inline __attribute__((always_inline)) VectorDD vdd_sqr(VectorDD a)
+{
+    KERNEL_V p = V_MUL(a.hi, a.hi);
+    KERNEL_V e = V_PROD_ERROR(a.hi, a.hi, p);
+    e = V_ADD(e, V_MUL(V_ADD(a.hi, a.hi), a.lo));
+
+    return vdd_quick_two_sum(p, e);
+}
+
+static inline __attribute__((always_inline))
+void KERNEL_BODY(const DoubleDouble *cr, const DoubleDouble *ci, int count, int iterations,
+        int *out, int *out_mirror, float *out_fraction, float *out_fraction_mirror, const bool mirror)
+{
+    _Alignas(64) double lane_cr_hi[KERNEL_LANES];
+    _Alignas(64) double lane_cr_lo[KERNEL_LANES];
+    _Alignas(64) double lane_ci_hi[KERNEL_LANES];
+    _Alignas(64) double lane_ci_lo[KERNEL_LANES];
+    _Alignas(64) double lane_zr_hi[KERNEL_LANES];
+    _Alignas(64) double lane_zr_lo[KERNEL_LANES];
+    _Alignas(64) double lane_zi_hi[KERNEL_LANES];
+    _Alignas(64) double lane_zi_lo[KERNEL_LANES];
+    _Alignas(64) double lane_saved_zr_hi[KERNEL_LANES];
+    _Alignas(64) double lane_saved_zr_lo[KERNEL_LANES];
+    _Alignas(64) double lane_saved_zi_hi[KERNEL_LANES];
+    _Alignas(64) double lane_saved_zi_lo[KERNEL_LANES];
+    _Alignas(64) double lane_countdown[KERNEL_LANES];
+    _Alignas(64) double lane_interval[KERNEL_LANES];
+    int lane_pixel[KERNEL_LANES];
+    long lane_start[KERNEL_LANES];
+
+    if (!mirror) out_fraction_mirror = NULL;
+
+    if (iterations <= 0) {
+        for (int i = 0; i < count; ++i) out[i] = 0;
+        if (mirror) {
+            for (int i = 0; i < count; ++i) out_mirror[i] = 0;
+        }
+        if (out_fraction != NULL) {
+            for (int i = 0; i < count; ++i) out_fraction[i] = 0.0f;
+        }
+        if (out_fraction_mirror != NULL) {
+            for (int i = 0; i < count; ++i) out_fraction_mirror[i] = 0.0f;
+        }
+        return;
+    }
+
+    unsigned resolved = 0;
+    unsigned resolved_mirror = mirror ? 0 : ~0u;
+
+    long step = 0;
+    int next = 0;
+    int active = 0;
+
+#define lane_assign(lane, pixel, at) do { \
+        lane_cr_hi[lane] = lane_zr_hi[lane] = lane_saved_zr_hi[lane] = cr[pixel].hi; \
+        lane_cr_lo[lane] = lane_zr_lo[lane] = lane_saved_zr_lo[lane] = cr[pixel].lo; \
+        lane_ci_hi[lane] = lane_zi_hi[lane] = lane_saved_zi_hi[lane] = ci[pixel].hi; \
+        lane_ci_lo[lane] = lane_zi_lo[lane] = lane_saved_zi_lo[lane] = ci[pixel].lo; \
+        lane_countdown[lane] = lane_interval[lane] = PERIOD_FIRST_INTERVAL; \
+        lane_pixel[lane] = (pixel); \
+        lane_start[lane] = (at); \
+        resolved &= ~(1u << (lane)); \
+        if (mirror) resolved_mirror &= ~(1u << (lane)); \
+    } while (0)
+
+#define lane_retire(lane) do { \
+        lane_cr_hi[lane] = lane_cr_lo[lane] = lane_zr_hi[lane] = lane_zr_lo[lane] = 0; \
+        lane_ci_hi[lane] = lane_ci_lo[lane] = lane_zi_hi[lane] = lane_zi_lo[lane] = 0; \
+        lane_saved_zr_hi[lane] = lane_saved_zi_hi[lane] = 1; \
+        lane_saved_zr_lo[lane] = lane_saved_zi_lo[lane] = 0; \
+        lane_countdown[lane] = lane_interval[lane] = 1e30; \
+        lane_pixel[lane] = -1; \
+        lane_start[lane] = LONG_MAX - iterations; \
+        resolved |= 1u << (lane); \
+        resolved_mirror |= 1u << (lane); \
+    } while (0)
+
+#define settle(counts, fractions, pixel, value, fraction) do { \
+        (counts)[pixel] = (value); \
+        if ((fractions) != NULL) (fractions)[pixel] = (fraction); \
+    } while (0)
+
+    for (int lane = 0; lane < KERNEL_LANES; ++lane) {
+        if (next < count) {
+            lane_assign(lane, next, 0);
+            ++next;
+            ++active;
+        } else {
+            lane_retire(lane);
+        }
+    }
+
+    VectorDD vcr, vci, vzr, vzi, vszr, vszi;
+    KERNEL_V vcountdown, vinterval;
+
+#define lanes_load() do { \
+        vcr = (VectorDD){ V_LOAD(lane_cr_hi), V_LOAD(lane_cr_lo) }; \
+        vci = (VectorDD){ V_LOAD(lane_ci_hi), V_LOAD(lane_ci_lo) }; \
+        vzr = (VectorDD){ V_LOAD(lane_zr_hi), V_LOAD(lane_zr_lo) }; \
+        vzi = (VectorDD){ V_LOAD(lane_zi_hi), V_LOAD(lane_zi_lo) }; \
+        vszr = (VectorDD){ V_LOAD(lane_saved_zr_hi), V_LOAD(lane_saved_zr_lo) }; \
+        vszi = (VectorDD){ V_LOAD(lane_saved_zi_hi), V_LOAD(lane_saved_zi_lo) }; \
+        vcountdown = V_LOAD(lane_countdown); \
+        vinterval = V_LOAD(lane_interval); \
+    } while (0)
+
+    lanes_load();
+
+    const KERNEL_V limit = V_SET1(MANDEL_INFINITY);
+    const KERNEL_V epsilon = V_SET1(KERNEL_EPSILON);
+    const KERNEL_V max_interval = V_SET1((double)PERIOD_MAX_INTERVAL);
+    const KERNEL_V one = V_SET1(1.0);
+    const KERNEL_V zero = V_SET1(0.0);
+
+    long deadline = (long)iterations;
+
+    while (active > 0) {
+        VectorDD zr2 = vdd_sqr(vzr);
+        VectorDD zi2 = vdd_sqr(vzi);
+        VectorDD zri = vdd_mul(vzr, vzi);
+
+        vzr = vdd_add(vdd_add(zr2, (VectorDD){ V_SUB(zero, zi2.hi), V_SUB(zero, zi2.lo) }), vcr);
+        vzi = vdd_add((VectorDD){ V_ADD(zri.hi, zri.hi), V_ADD(zri.lo, zri.lo) }, vci);
+        ++step;
+
+        unsigned escaped = V_BITS(V_GT(V_ABS(V_ADD(vzr.hi, vzi.hi)), limit)) & ~resolved;
+        unsigned escaped_mirror = 0;
+        if (mirror) {
+            escaped_mirror = V_BITS(V_GT(V_ABS(V_SUB(vzr.hi, vzi.hi)), limit)) & ~resolved_mirror;
+        }
+        KERNEL_V distance = V_ADD(V_ABS(V_ADD(V_SUB(vzr.hi, vszr.hi), V_SUB(vzr.lo, vszr.lo))),
+                V_ABS(V_ADD(V_SUB(vzi.hi, vszi.hi), V_SUB(vzi.lo, vszi.lo))));
+        unsigned periodic = V_BITS(V_LT(distance, epsilon));
+
+        vcountdown = V_SUB(vcountdown, one);
+        KERNEL_M save = V_LE(vcountdown, zero);
+        if (V_BITS(save) != 0) {
+            vszr.hi = V_SELECT(save, vzr.hi, vszr.hi);
+            vszr.lo = V_SELECT(save, vzr.lo, vszr.lo);
+            vszi.hi = V_SELECT(save, vzi.hi, vszi.hi);
+            vszi.lo = V_SELECT(save, vzi.lo, vszi.lo);
+            KERNEL_V doubled = V_ADD(vinterval, vinterval);
+            KERNEL_V grown = V_SELECT(V_LE(doubled, max_interval), doubled, vinterval);
+            vinterval = V_SELECT(save, grown, vinterval);
+            vcountdown = V_SELECT(save, vinterval, vcountdown);
+        }
+
+        if ((escaped | escaped_mirror | periodic) == 0 && step < deadline) continue;
+
+        V_STORE(lane_zr_hi, vzr.hi);
+        V_STORE(lane_zr_lo, vzr.lo);
+        V_STORE(lane_zi_hi, vzi.hi);
+        V_STORE(lane_zi_lo, vzi.lo);
+        V_STORE(lane_saved_zr_hi, vszr.hi);
+        V_STORE(lane_saved_zr_lo, vszr.lo);
+        V_STORE(lane_saved_zi_hi, vszi.hi);
+        V_STORE(lane_saved_zi_lo, vszi.lo);
+        V_STORE(lane_countdown, vcountdown);
+        V_STORE(lane_interval, vinterval);
+        deadline = LONG_MAX;
+
+        for (int lane = 0; lane < KERNEL_LANES; ++lane) {
+            if (lane_pixel[lane] >= 0) {
+                unsigned bit = 1u << lane;
+                int pixel = lane_pixel[lane];
+                int local = (int)(step - lane_start[lane]);
+
+                if (escaped & bit) {
+                    settle(out, out_fraction, pixel, local - 1,
+                            escape_fraction(cr[pixel].hi, ci[pixel].hi, lane_zr_hi[lane], lane_zi_hi[lane]));
+                    resolved |= bit;
+                }
+                if (escaped_mirror & bit) {
+                    settle(out_mirror, out_fraction_mirror, pixel, local - 1,
+                            escape_fraction(cr[pixel].hi, ci[pixel].hi, lane_zr_hi[lane], lane_zi_hi[lane]));
+                    resolved_mirror |= bit;
+                }
+
+                if ((periodic & bit) || local == iterations) {
+                    if (!(resolved & bit)) settle(out, out_fraction, pixel, iterations, 0.0f);
+                    if (!(resolved_mirror & bit)) settle(out_mirror, out_fraction_mirror, pixel, iterations, 0.0f);
+                    resolved |= bit;
+                    resolved_mirror |= bit;
+                }
+
+                if ((resolved & resolved_mirror & bit) != 0) {
+                    if (next < count) {
+                        lane_assign(lane, next, step);
+                        ++next;
+                    } else {
+                        lane_retire(lane);
+                        --active;
+                    }
+                }
+            }
+
+            if (lane_start[lane] + iterations < deadline) {
+                deadline = lane_start[lane] + iterations;
+            }
+        }
+
+        lanes_load();
+    }
+
+#undef lane_assign
+#undef lane_retire
+#undef lanes_load
+#undef settle
+}
+
+void KERNEL_NAME(const DoubleDouble *cr, const DoubleDouble *ci, int count, int iterations, int *out, int *out_mirror,
+        float *out_fraction, float *out_fraction_mirror)
+{
+    if (out_mirror != NULL) {
+        KERNEL_BODY(cr, ci, count, iterations, out, out_mirror, out_fraction, out_fraction_mirror, true);
+    } else {
+        KERNEL_BODY(cr, ci, count, iterations, out, NULL, out_fraction, NULL, false);
+    }
+}
+
+#undef KERNEL_BODY
@@ -0,0 +1,127 @@
+#ifndef KERNEL_FE_H
+#define KERNEL_FE_H
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+// Extended-exponent arithmetic. A value is m * 2^e with a double mantissa
+// normalized to 0.5 <= |m| < 1 and a separate integer exponent, so it keeps
+// the 53 bits of a double at magnitudes far below 1e-308. Zero has m = 0 and
+// the smallest exponent.
+
+#define FE_ZERO_EXPONENT (-(1L << 40))
+
+typedef struct {
+    double m;
+    long e;
+} FloatExp;
+
+static inline FloatExp fe_zero(void)
+{
+    return (FloatExp){ 0.0, FE_ZERO_EXPONENT };
+}
+
+// 2^e for exponents a double can hold without going subnormal
+static inline double fe_pow2(long e)
+{
+    uint64_t bits = (uint64_t)(e + 1023) << 52;
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+
+    return value;
+}
+
+// Brings m * 2^e back to normal form, reading the exponent out of the bits
+// of m instead of calling frexp()
+static inline FloatExp fe_normalize(double m, long e)
+{
+    if (m == 0.0) return fe_zero();
+
+    uint64_t bits;
+    memcpy(&bits, &m, sizeof(bits));
+    int biased = (int)((bits >> 52) & 0x7ff);
+    if (biased == 0) {
+        int shift;
+        m = frexp(m, &shift);
+        return (FloatExp){ m, e + shift };
+    }
+
+    bits = (bits & ~(0x7ffULL << 52)) | (1022ULL << 52);
+    memcpy(&m, &bits, sizeof(m));
+
+    return (FloatExp){ m, e + biased - 1022 };
+}
+
+static inline FloatExp fe_from_double(double value)
+{
+    return fe_normalize(value, 0);
+}
+
+static inline FloatExp fe_from_long_double(long double value)
+{
+    if (value == 0.0L) return fe_zero();
+
+    int e;
+    long double m = frexpl(value, &e);
+
+    return (FloatExp){ (double)m, e };
+}
+
+// Flushes to zero below the range of a double
+static inline double fe_to_double(FloatExp a)
+{
+    if (a.e < -1074) return 0.0;
+    if (a.e > 1024) return copysign(INFINITY, a.m);
+
+    return ldexp(a.m, (int)a.e);
+}
+
+static inline FloatExp fe_neg(FloatExp a)
+{
+    return (FloatExp){ -a.m, a.e };
+}
+
+static inline FloatExp fe_mul(FloatExp a, FloatExp b)
+{
+    return fe_normalize(a.m * b.m, a.e + b.e);
+}
+
+static inline FloatExp fe_mul_double(FloatExp a, double b)
+{
+    return fe_normalize(a.m * b, a.e);
+}
+
+// The smaller operand is aligned to the larger one, and dropped when it is
+// below its last bit anyway
+static inline FloatExp fe_add(FloatExp a, FloatExp b)
+{
+    if (a.e < b.e) {
+        FloatExp t = a;
+        a = b;
+        b = t;
+    }
+
+    long shift = b.e - a.e;
+    if (shift < -60) return a;
+
+    return fe_normalize(a.m + b.m * fe_pow2(shift), a.e);
+}
+
+static inline FloatExp fe_sub(FloatExp a, FloatExp b)
+{
+    return fe_add(a, fe_neg(b));
+}
+
+// |a| < |b|
+static inline bool fe_abs_less(FloatExp a, FloatExp b)
+{
+    if (a.m == 0.0) return b.m != 0.0;
+    if (b.m == 0.0) return false;
+    if (a.e != b.e) return a.e < b.e;
+
+    return fabs(a.m) < fabs(b.m);
+}
+
+#endif // KERNEL_FE_H
@@ -0,0 +1,72 @@
+#ifndef KERNEL_FX_H
+#define KERNEL_FX_H
+
+#include <math.h>
+#include <stdint.h>
+
+// 128-bit fixed point. A value is a signed __int128 counting units of
+// 2^-FIXED_FRACTION_BITS, which leaves 15 integer bits: enough for every
+// intermediate of an orbit that has not escaped yet (see the kernel). The
+// arithmetic is integer only and truncates towards zero, so the results are
+// the same bits on every host with 64x64->128 multiplies.
+
+#define FIXED_FRACTION_BITS 112
+
+typedef __int128 Fixed128;
+
+#define FIXED_ONE ((Fixed128)1 << FIXED_FRACTION_BITS)
+#define FIXED_COORDINATE_LIMIT 64
+
+static inline unsigned __int128 fx_abs(Fixed128 a)
+{
+    return (a < 0) ? -(unsigned __int128)a : (unsigned __int128)a;
+}
+
+// Nearest double, rounded once
+static inline double fx_to_double(Fixed128 a)
+{
+    return ldexp((double)a, -FIXED_FRACTION_BITS);
+}
+
+// Bits FIXED_FRACTION_BITS and up of the 256-bit product of two magnitudes,
+// from four 64x64->128 partial products
+static inline unsigned __int128 fx_mul_magnitude(unsigned __int128 a, unsigned __int128 b)
+{
+    uint64_t a_lo = (uint64_t)a, a_hi = (uint64_t)(a >> 64);
+    uint64_t b_lo = (uint64_t)b, b_hi = (uint64_t)(b >> 64);
+
+    unsigned __int128 ll = (unsigned __int128)a_lo * b_lo;
+    unsigned __int128 lh = (unsigned __int128)a_lo * b_hi;
+    unsigned __int128 hl = (unsigned __int128)a_hi * b_lo;
+    unsigned __int128 hh = (unsigned __int128)a_hi * b_hi;
+
+    unsigned __int128 mid = (ll >> 64) + (uint64_t)lh + (uint64_t)hl;
+    unsigned __int128 hi = hh + (lh >> 64) + (hl >> 64) + (mid >> 64);
+
+    return (hi << (128 - FIXED_FRACTION_BITS)) | ((uint64_t)mid >> (FIXED_FRACTION_BITS - 64));
+}
+
+static inline Fixed128 fx_mul(Fixed128 a, Fixed128 b)
+{
+    Fixed128 product = (Fixed128)fx_mul_magnitude(fx_abs(a), fx_abs(b));
+
+    return ((a < 0) != (b < 0)) ? -product : product;
+}
+
+// The same bits as fx_mul(a, a), with the cross product taken once
+static inline Fixed128 fx_sqr(Fixed128 a)
+{
+    unsigned __int128 magnitude = fx_abs(a);
+    uint64_t lo = (uint64_t)magnitude, hi = (uint64_t)(magnitude >> 64);
+
+    unsigned __int128 ll = (unsigned __int128)lo * lo;
+    unsigned __int128 lh = (unsigned __int128)lo * hi;
+    unsigned __int128 hh = (unsigned __int128)hi * hi;
+
+    unsigned __int128 mid = (ll >> 64) + 2*(unsigned __int128)(uint64_t)lh;
+    unsigned __int128 top = hh + 2*(lh >> 64) + (mid >> 64);
+
+    return (Fixed128)((top << (128 - FIXED_FRACTION_BITS)) | ((uint64_t)mid >> (FIXED_FRACTION_BITS - 64)));
+}
+
+#endif // KERNEL_FX_H
@@ -0,0 +1,141 @@
+// Generic scalar escape-time kernel, included once per type.
+//
+// The including file defines:
+//   KERNEL_NAME        name of the generated function
+//   KERNEL_RESUME_NAME name of the function that resumes orbits, optional
+//   KERNEL_T           scalar type
+//   KERNEL_ABS         absolute value for KERNEL_T
+//   KERNEL_EPSILON     periodicity tolerance for KERNEL_T
+
+#define KERNEL_CONCAT_(a, b) a##b
+#define KERNEL_CONCAT(a, b) KERNEL_CONCAT_(a, b)
+#define KERNEL_ORBIT KERNEL_CONCAT(KERNEL_NAME, _orbit)
+
+// Iterates one orbit on from z = *zr + *zi*i after `i` steps up to
+// `iterations`, leaving the last z in *zr and *zi. `escaped` and
+// `escaped_mirror` hold the counts found so far, -1 while the orbit (or its
+// conjugate) goes on, and `fraction` and `fraction_mirror` get the fraction
+// of the ones found here. Returns the steps done, which are short of
+// `iterations` when the orbit was found periodic before both escaped.
+static inline int KERNEL_ORBIT(KERNEL_T c_real, KERNEL_T c_imag, KERNEL_T *zr, KERNEL_T *zi, int i, int iterations,
+        int *escaped_out, int *escaped_mirror_out, float *fraction, float *fraction_mirror)
+{
+    KERNEL_T z_real = *zr;
+    KERNEL_T z_imag = *zi;
+
+    KERNEL_T saved_real = z_real;
+    KERNEL_T saved_imag = z_imag;
+    int save_interval = PERIOD_FIRST_INTERVAL;
+    int save_at = PERIOD_FIRST_INTERVAL;
+    while (save_at <= i) {
+        if (save_interval*2 <= PERIOD_MAX_INTERVAL) save_interval *= 2;
+        save_at += save_interval;
+    }
+
+    // The conjugate orbit is the mirror image of this one, it escapes
+    // when |Re(z) - Im(z)| gets too big
+    int escaped = *escaped_out;
+    int escaped_mirror = *escaped_mirror_out;
+
+    for (; i < iterations; ++i) {
+        KERNEL_T new_z_real = z_real*z_real - z_imag*z_imag;
+        KERNEL_T new_z_imag = 2*z_real*z_imag;
+
+        z_real = new_z_real + c_real;
+        z_imag = new_z_imag + c_imag;
+
+        if (escaped < 0 && KERNEL_ABS(z_real + z_imag) > MANDEL_INFINITY) {
+            escaped = i;
+            *fraction = escape_fraction(c_real, c_imag, z_real, z_imag);
+        }
+        if (escaped_mirror < 0 && KERNEL_ABS(z_real - z_imag) > MANDEL_INFINITY) {
+            escaped_mirror = i;
+            *fraction_mirror = escape_fraction(c_real, c_imag, z_real, z_imag);
+        }
+        if (escaped >= 0 && escaped_mirror >= 0) {
+            break;
+        }
+
+        if (KERNEL_ABS(z_real - saved_real) + KERNEL_ABS(z_imag - saved_imag) < KERNEL_EPSILON) {
+            break;
+        }
+
+        if (i + 1 == save_at) {
+            saved_real = z_real;
+            saved_imag = z_imag;
+            if (save_interval*2 <= PERIOD_MAX_INTERVAL) save_interval *= 2;
+            save_at += save_interval;
+        }
+    }
+
+    *zr = z_real;
+    *zi = z_imag;
+    *escaped_out = escaped;
+    *escaped_mirror_out = escaped_mirror;
+
+    return i;
+}
+
+void KERNEL_NAME(const KERNEL_T *cr, const KERNEL_T *ci, int count, int iterations, int *out, int *out_mirror,
+        KERNEL_T *out_zr, KERNEL_T *out_zi, float *out_fraction, float *out_fraction_mirror)
+{
+    if (iterations < 0) iterations = 0;
+
+    for (int p = 0; p < count; ++p) {
+        KERNEL_T z_real = cr[p];
+        KERNEL_T z_imag = ci[p];
+        int escaped = -1;
+        int escaped_mirror = (out_mirror != NULL) ? -1 : 0;
+        float fraction = 0.0f;
+        float fraction_mirror = 0.0f;
+
+        int steps = KERNEL_ORBIT(cr[p], ci[p], &z_real, &z_imag, 0, iterations, &escaped, &escaped_mirror,
+                &fraction, &fraction_mirror);
+
+        out[p] = (escaped >= 0) ? escaped : iterations;
+        if (out_mirror != NULL) {
+            out_mirror[p] = (escaped_mirror >= 0) ? escaped_mirror : iterations;
+        }
+        if (out_fraction != NULL) out_fraction[p] = fraction;
+        if (out_fraction_mirror != NULL && out_mirror != NULL) out_fraction_mirror[p] = fraction_mirror;
+        if (out_zr != NULL && (escaped < 0 || escaped_mirror < 0)) {
+            out_zr[p] = (steps < iterations) ? NAN : z_real;
+            out_zi[p] = (steps < iterations) ? NAN : z_imag;
+        }
+    }
+}
+
+#ifdef KERNEL_RESUME_NAME
+void KERNEL_RESUME_NAME(const KERNEL_T *cr, const KERNEL_T *ci, KERNEL_T *zr, KERNEL_T *zi, int count, int from,
+        int iterations, int *out, int *out_mirror, float *out_fraction, float *out_fraction_mirror)
+{
+    for (int p = 0; p < count; ++p) {
+        int escaped = (out[p] == from) ? -1 : out[p];
+        int escaped_mirror = (out_mirror != NULL && out_mirror[p] == from) ? -1 : 0;
+        float fraction = 0.0f;
+        float fraction_mirror = 0.0f;
+
+        // Periodic orbits stay at the limit, whatever it is
+        int steps = iterations;
+        if (!isnan(zr[p])) {
+            steps = KERNEL_ORBIT(cr[p], ci[p], &zr[p], &zi[p], from, iterations, &escaped, &escaped_mirror,
+                    &fraction, &fraction_mirror);
+        }
+
+        if (out[p] == from) {
+            out[p] = (escaped >= 0) ? escaped : iterations;
+            if (out_fraction != NULL) out_fraction[p] = fraction;
+        }
+        if (out_mirror != NULL && out_mirror[p] == from) {
+            out_mirror[p] = (escaped_mirror >= 0) ? escaped_mirror : iterations;
+            if (out_fraction_mirror != NULL) out_fraction_mirror[p] = fraction_mirror;
+        }
+        if ((escaped < 0 || escaped_mirror < 0) && steps < iterations) {
+            zr[p] = NAN;
+            zi[p] = NAN;
+        }
+    }
+}
+#endif
+
+#undef KERNEL_ORBIT
@@ -0,0 +1,302 @@
+// Generic SIMD escape-time kernel, included once per ISA and type.
+//
+// The including file defines:
+//   KERNEL_NAME        name of the generated function
+//   KERNEL_RESUME_NAME name of the function that resumes orbits, optional
+//   KERNEL_T           scalar type (float or double)
+//   KERNEL_V           vector type holding KERNEL_LANES scalars
+//   KERNEL_M           result type of the comparisons
+//   KERNEL_EPSILON     periodicity tolerance for KERNEL_T
+//   V_SET1(x)          broadcast
+//   V_LOAD(p)          aligned load
+//   V_STORE(p, v)      aligned store
+//   V_ADD, V_SUB, V_MUL, V_ABS
+//   V_GT, V_LT, V_LE   lane-wise comparisons returning a KERNEL_M
+//   V_BITS(m)          bitmask of the lanes set in m
+//   V_SELECT(m, a, b)  a in the lanes set in m, b elsewhere
+//
+// Every lane iterates its own pixel. As soon as a lane escapes, is found to
+// be periodic or reaches the iteration limit its result is written out and
+// the lane is refilled with the next pending pixel, so no lane idles while
+// the slowest one finishes. Periodicity checkpoints are kept per lane in
+// registers. The arithmetic and the checkpoint schedule mirror the scalar
+// kernel operation by operation, which keeps the iteration counts identical.
+//
+// With `mirror` set a lane also tracks the escape of the conjugate orbit and
+// is only retired once both are resolved. The fraction of an escape is
+// worked out from the lane's z when it retires the count, which is rare
+// enough to stay out of the vector loop. With `resume` set lanes start
+// from z in `zr` and `zi` after `from` steps instead, as the scalar
+// resume does. Both flags are compile-time constants in each instantiation
+// below.
+
+#include <limits.h>
+#include <math.h>
+#include <stdbool.h>
+
+#define KERNEL_CONCAT_(a, b) a##b
+#define KERNEL_CONCAT(a, b) KERNEL_CONCAT_(a, b)
+#define KERNEL_BODY KERNEL_CONCAT(KERNEL_NAME, _body)
+
+static inline __attribute__((always_inline))
+void KERNEL_BODY(const KERNEL_T *cr, const KERNEL_T *ci, const KERNEL_T *zr, const KERNEL_T *zi, int count,
+        int from, int iterations, int *out, int *out_mirror, KERNEL_T *out_zr, KERNEL_T *out_zi,
+        float *out_fraction, float *out_fraction_mirror, const bool mirror, const bool resume)
+{
+    _Alignas(64) KERNEL_T lane_cr[KERNEL_LANES];
+    _Alignas(64) KERNEL_T lane_ci[KERNEL_LANES];
+    _Alignas(64) KERNEL_T lane_zr[KERNEL_LANES];
+    _Alignas(64) KERNEL_T lane_zi[KERNEL_LANES];
+    _Alignas(64) KERNEL_T lane_saved_zr[KERNEL_LANES];
+    _Alignas(64) KERNEL_T lane_saved_zi[KERNEL_LANES];
+    _Alignas(64) KERNEL_T lane_countdown[KERNEL_LANES];
+    _Alignas(64) KERNEL_T lane_interval[KERNEL_LANES];
+    int lane_pixel[KERNEL_LANES];
+    long lane_start[KERNEL_LANES];
+
+    if (!mirror) out_fraction_mirror = NULL;
+
+    if (resume && iterations <= from) {
+        for (int i = 0; i < count; ++i) {
+            if (out[i] == from) out[i] = iterations;
+            if (mirror && out_mirror[i] == from) out_mirror[i] = iterations;
+        }
+        return;
+    }
+    if (!resume && iterations <= 0) {
+        for (int i = 0; i < count; ++i) out[i] = 0;
+        if (mirror) {
+            for (int i = 0; i < count; ++i) out_mirror[i] = 0;
+        }
+        if (out_fraction != NULL) {
+            for (int i = 0; i < count; ++i) out_fraction[i] = 0.0f;
+        }
+        if (out_fraction_mirror != NULL) {
+            for (int i = 0; i < count; ++i) out_fraction_mirror[i] = 0.0f;
+        }
+        if (out_zr != NULL) {
+            for (int i = 0; i < count; ++i) {
+                out_zr[i] = cr[i];
+                out_zi[i] = ci[i];
+            }
+        }
+        return;
+    }
+
+    // Lanes whose orbit (or conjugate orbit) already escaped
+    unsigned resolved = 0;
+    unsigned resolved_mirror = mirror ? 0 : ~0u;
+
+    long step = 0;
+    int next = 0;
+    int active = 0;
+
+    // Where the checkpoint schedule stands after `from` steps
+    int first_interval = PERIOD_FIRST_INTERVAL;
+    int first_save_at = PERIOD_FIRST_INTERVAL;
+    while (resume && first_save_at <= from) {
+        if (first_interval*2 <= PERIOD_MAX_INTERVAL) first_interval *= 2;
+        first_save_at += first_interval;
+    }
+
+    // Lanes start at z = c, or where a resumed orbit stopped, and remember
+    // z at steps 8, 24, 56, ... of their own orbit (Brent's doubling
+    // intervals). Resumed counts other than `from` are already resolved.
+#define lane_assign(lane, pixel, at) do { \
+        lane_cr[lane] = cr[pixel]; \
+        lane_ci[lane] = ci[pixel]; \
+        lane_zr[lane] = lane_saved_zr[lane] = resume ? zr[pixel] : cr[pixel]; \
+        lane_zi[lane] = lane_saved_zi[lane] = resume ? zi[pixel] : ci[pixel]; \
+        lane_countdown[lane] = first_save_at - from; \
+        lane_interval[lane] = first_interval; \
+        lane_pixel[lane] = (pixel); \
+        lane_start[lane] = (at) - from; \
+        resolved &= ~(1u << (lane)); \
+        if (resume && out[pixel] != from) resolved |= 1u << (lane); \
+        if (mirror) resolved_mirror &= ~(1u << (lane)); \
+        if (mirror && resume && out_mirror[pixel] != from) resolved_mirror |= 1u << (lane); \
+    } while (0)
+
+    // Resumed orbits that were found periodic stay at the limit
+#define skip_periodic() do { \
+        while (resume && next < count && isnan(zr[next])) { \
+            if (out[next] == from) out[next] = iterations; \
+            if (mirror && out_mirror[next] == from) out_mirror[next] = iterations; \
+            ++next; \
+        } \
+    } while (0)
+
+    // Every count a lane settles takes its fraction along
+#define settle(counts, fractions, pixel, value, fraction) do { \
+        (counts)[pixel] = (value); \
+        if ((fractions) != NULL) (fractions)[pixel] = (fraction); \
+    } while (0)
+
+    // Idle lanes iterate z = 0, c = 0 which never escapes nor needs saving
+#define lane_retire(lane) do { \
+        lane_cr[lane] = lane_zr[lane] = 0; \
+        lane_ci[lane] = lane_zi[lane] = 0; \
+        lane_saved_zr[lane] = lane_saved_zi[lane] = 1; \
+        lane_countdown[lane] = lane_interval[lane] = (KERNEL_T)1e30; \
+        lane_pixel[lane] = -1; \
+        lane_start[lane] = LONG_MAX - iterations; \
+        resolved |= 1u << (lane); \
+        resolved_mirror |= 1u << (lane); \
+    } while (0)
+
+    for (int lane = 0; lane < KERNEL_LANES; ++lane) {
+        skip_periodic();
+        if (next < count) {
+            lane_assign(lane, next, 0);
+            ++next;
+            ++active;
+        } else {
+            lane_retire(lane);
+        }
+    }
+
+    KERNEL_V vcr = V_LOAD(lane_cr);
+    KERNEL_V vci = V_LOAD(lane_ci);
+    KERNEL_V vzr = V_LOAD(lane_zr);
+    KERNEL_V vzi = V_LOAD(lane_zi);
+    KERNEL_V vszr = V_LOAD(lane_saved_zr);
+    KERNEL_V vszi = V_LOAD(lane_saved_zi);
+    KERNEL_V vcountdown = V_LOAD(lane_countdown);
+    KERNEL_V vinterval = V_LOAD(lane_interval);
+
+    const KERNEL_V limit = V_SET1((KERNEL_T)MANDEL_INFINITY);
+    const KERNEL_V epsilon = V_SET1(KERNEL_EPSILON);
+    const KERNEL_V max_interval = V_SET1((KERNEL_T)PERIOD_MAX_INTERVAL);
+    const KERNEL_V one = V_SET1((KERNEL_T)1);
+    const KERNEL_V zero = V_SET1((KERNEL_T)0);
+
+    long deadline = (long)iterations - from;
+
+    while (active > 0) {
+        KERNEL_V zr2 = V_MUL(vzr, vzr);
+        KERNEL_V zi2 = V_MUL(vzi, vzi);
+        KERNEL_V new_zi = V_MUL(V_ADD(vzr, vzr), vzi);
+
+        vzr = V_ADD(V_SUB(zr2, zi2), vcr);
+        vzi = V_ADD(new_zi, vci);
+        ++step;
+
+        unsigned escaped = V_BITS(V_GT(V_ABS(V_ADD(vzr, vzi)), limit)) & ~resolved;
+        unsigned escaped_mirror = 0;
+        if (mirror) {
+            escaped_mirror = V_BITS(V_GT(V_ABS(V_SUB(vzr, vzi)), limit)) & ~resolved_mirror;
+        }
+        KERNEL_V distance = V_ADD(V_ABS(V_SUB(vzr, vszr)), V_ABS(V_SUB(vzi, vszi)));
+        unsigned periodic = V_BITS(V_LT(distance, epsilon));
+
+        vcountdown = V_SUB(vcountdown, one);
+        KERNEL_M save = V_LE(vcountdown, zero);
+        if (V_BITS(save) != 0) {
+            vszr = V_SELECT(save, vzr, vszr);
+            vszi = V_SELECT(save, vzi, vszi);
+            KERNEL_V doubled = V_ADD(vinterval, vinterval);
+            KERNEL_V grown = V_SELECT(V_LE(doubled, max_interval), doubled, vinterval);
+            vinterval = V_SELECT(save, grown, vinterval);
+            vcountdown = V_SELECT(save, vinterval, vcountdown);
+        }
+
+        if ((escaped | escaped_mirror | periodic) == 0 && step < deadline) continue;
+
+        // Retire finished lanes and refill them with pending pixels
+        V_STORE(lane_zr, vzr);
+        V_STORE(lane_zi, vzi);
+        V_STORE(lane_saved_zr, vszr);
+        V_STORE(lane_saved_zi, vszi);
+        V_STORE(lane_countdown, vcountdown);
+        V_STORE(lane_interval, vinterval);
+        deadline = LONG_MAX;
+
+        for (int lane = 0; lane < KERNEL_LANES; ++lane) {
+            if (lane_pixel[lane] >= 0) {
+                unsigned bit = 1u << lane;
+                int pixel = lane_pixel[lane];
+                int local = (int)(step - lane_start[lane]);
+
+                if (escaped & bit) {
+                    settle(out, out_fraction, pixel, local - 1,
+                            escape_fraction(cr[pixel], ci[pixel], lane_zr[lane], lane_zi[lane]));
+                    resolved |= bit;
+                }
+                if (escaped_mirror & bit) {
+                    settle(out_mirror, out_fraction_mirror, pixel, local - 1,
+                            escape_fraction(cr[pixel], ci[pixel], lane_zr[lane], lane_zi[lane]));
+                    resolved_mirror |= bit;
+                }
+
+                // Periodic orbits and the iteration limit settle both
+                if ((periodic & bit) || local == iterations) {
+                    if (out_zr != NULL && (resolved & resolved_mirror & bit) == 0) {
+                        out_zr[pixel] = (periodic & bit) ? (KERNEL_T)NAN : lane_zr[lane];
+                        out_zi[pixel] = (periodic & bit) ? (KERNEL_T)NAN : lane_zi[lane];
+                    }
+                    if (!(resolved & bit)) settle(out, out_fraction, pixel, iterations, 0.0f);
+                    if (!(resolved_mirror & bit)) settle(out_mirror, out_fraction_mirror, pixel, iterations, 0.0f);
+                    resolved |= bit;
+                    resolved_mirror |= bit;
+                }
+
+                if ((resolved & resolved_mirror & bit) != 0) {
+                    skip_periodic();
+                    if (next < count) {
+                        lane_assign(lane, next, step);
+                        ++next;
+                    } else {
+                        lane_retire(lane);
+                        --active;
+                    }
+                }
+            }
+
+            if (lane_start[lane] + iterations < deadline) {
+                deadline = lane_start[lane] + iterations;
+            }
+        }
+
+        vcr = V_LOAD(lane_cr);
+        vci = V_LOAD(lane_ci);
+        vzr = V_LOAD(lane_zr);
+        vzi = V_LOAD(lane_zi);
+        vszr = V_LOAD(lane_saved_zr);
+        vszi = V_LOAD(lane_saved_zi);
+        vcountdown = V_LOAD(lane_countdown);
+        vinterval = V_LOAD(lane_interval);
+    }
+
+#undef lane_assign
+#undef lane_retire
+#undef skip_periodic
+#undef settle
+}
+
+void KERNEL_NAME(const KERNEL_T *cr, const KERNEL_T *ci, int count, int iterations, int *out, int *out_mirror,
+        KERNEL_T *out_zr, KERNEL_T *out_zi, float *out_fraction, float *out_fraction_mirror)
+{
+    if (out_mirror != NULL) {
+        KERNEL_BODY(cr, ci, NULL, NULL, count, 0, iterations, out, out_mirror, out_zr, out_zi,
+                out_fraction, out_fraction_mirror, true, false);
+    } else {
+        KERNEL_BODY(cr, ci, NULL, NULL, count, 0, iterations, out, NULL, out_zr, out_zi,
+                out_fraction, NULL, false, false);
+    }
+}
+
+#ifdef KERNEL_RESUME_NAME
+void KERNEL_RESUME_NAME(const KERNEL_T *cr, const KERNEL_T *ci, KERNEL_T *zr, KERNEL_T *zi, int count, int from,
+        int iterations, int *out, int *out_mirror, float *out_fraction, float *out_fraction_mirror)
+{
+    if (out_mirror != NULL) {
+        KERNEL_BODY(cr, ci, zr, zi, count, from, iterations, out, out_mirror, zr, zi,
+                out_fraction, out_fraction_mirror, true, true);
+    } else {
+        KERNEL_BODY(cr, ci, zr, zi, count, from, iterations, out, NULL, zr, zi,
+                out_fraction, NULL, false, true);
+    }
+}
+#endif
+
+#undef KERNEL_BODY
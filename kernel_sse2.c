@@ -0,0 +1,105 @@
+// Built with -msse2, only called when the CPU supports it
+#include "kernel.h"
+
+#include <emmintrin.h>
+
+static inline __m128 abs_ps(__m128 v) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), v); }
+static inline __m128 gt_ps(__m128 a, __m128 b) { return _mm_cmpgt_ps(a, b); }
+static inline __m128 lt_ps(__m128 a, __m128 b) { return _mm_cmplt_ps(a, b); }
+static inline __m128 le_ps(__m128 a, __m128 b) { return _mm_cmple_ps(a, b); }
+static inline __m128 select_ps(__m128 m, __m128 a, __m128 b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+
+static inline __m128d abs_pd(__m128d v) { return _mm_andnot_pd(_mm_set1_pd(-0.0), v); }
+static inline __m128d gt_pd(__m128d a, __m128d b) { return _mm_cmpgt_pd(a, b); }
+static inline __m128d lt_pd(__m128d a, __m128d b) { return _mm_cmplt_pd(a, b); }
+static inline __m128d le_pd(__m128d a, __m128d b) { return _mm_cmple_pd(a, b); }
+static inline __m128d select_pd(__m128d m, __m128d a, __m128d b) { return _mm_or_pd(_mm_and_pd(m, a), _mm_andnot_pd(m, b)); }
+
+#define KERNEL_NAME escape_sse2_float
+#define KERNEL_RESUME_NAME resume_sse2_float
+#define KERNEL_T float
+#define KERNEL_V __m128
+#define KERNEL_M __m128
+#define KERNEL_LANES 4
+#define KERNEL_EPSILON PERIOD_EPSILON_FLOAT
+#define V_SET1 _mm_set1_ps
+#define V_LOAD _mm_load_ps
+#define V_STORE _mm_store_ps
+#define V_ADD _mm_add_ps
+#define V_SUB _mm_sub_ps
+#define V_MUL _mm_mul_ps
+#define V_ABS abs_ps
+#define V_GT gt_ps
+#define V_LT lt_ps
+#define V_LE le_ps
+#define V_BITS _mm_movemask_ps
+#define V_SELECT select_ps
+#include "kernel_simd.h"
+#undef KERNEL_NAME
+#undef KERNEL_RESUME_NAME
+#undef KERNEL_T
+#undef KERNEL_V
+#undef KERNEL_M
+#undef KERNEL_LANES
+#undef KERNEL_EPSILON
+#undef V_SET1
+#undef V_LOAD
+#undef V_STORE
+#undef V_ADD
+#undef V_SUB
+#undef V_MUL
+#undef V_ABS
+#undef V_GT
+#undef V_LT
+#undef V_LE
+#undef V_BITS
+#undef V_SELECT
+
+#define KERNEL_NAME escape_sse2_double
+#define KERNEL_RESUME_NAME resume_sse2_double
+#define KERNEL_T double
+#define KERNEL_V __m128d
+#define KERNEL_M __m128d
+#define KERNEL_LANES 2
+#define KERNEL_EPSILON PERIOD_EPSILON_DOUBLE
+#define V_SET1 _mm_set1_pd
+#define V_LOAD _mm_load_pd
+#define V_STORE _mm_store_pd
+#define V_ADD _mm_add_pd
+#define V_SUB _mm_sub_pd
+#define V_MUL _mm_mul_pd
+#define V_ABS abs_pd
+#define V_GT gt_pd
+#define V_LT lt_pd
+#define V_LE le_pd
+#define V_BITS _mm_movemask_pd
+#define V_SELECT select_pd
+#include "kernel_simd.h"
+#undef KERNEL_RESUME_NAME
+
+// Double-double shares the double precision operations above. SSE2 has no
+// FMA, the product error comes from Dekker's splitting instead.
+static inline __m128d split_hi_pd(__m128d a)
+{
+    __m128d t = _mm_mul_pd(_mm_set1_pd(134217729.0), a); // 2^27 + 1
+    return _mm_sub_pd(t, _mm_sub_pd(t, a));
+}
+
+static inline __m128d prod_error_pd(__m128d a, __m128d b, __m128d p)
+{
+    __m128d a_hi = split_hi_pd(a);
+    __m128d a_lo = _mm_sub_pd(a, a_hi);
+    __m128d b_hi = split_hi_pd(b);
+    __m128d b_lo = _mm_sub_pd(b, b_hi);
+    __m128d e = _mm_sub_pd(_mm_mul_pd(a_hi, b_hi), p);
+    e = _mm_add_pd(e, _mm_mul_pd(a_hi, b_lo));
+    e = _mm_add_pd(e, _mm_mul_pd(a_lo, b_hi));
+    return _mm_add_pd(e, _mm_mul_pd(a_lo, b_lo));
+}
+
+#undef KERNEL_NAME
+#undef KERNEL_EPSILON
+#define KERNEL_NAME escape_sse2_double_double
+#define KERNEL_EPSILON PERIOD_EPSILON_DOUBLE_DOUBLE
+#define V_PROD_ERROR prod_error_pd
+#include "kernel_dd_simd.h"
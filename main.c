@@ -1,12 +1,21 @@
 #include <assert.h>
+#include <float.h>
 #include <pthread.h>
 #include <raylib.h>
 #include <raymath.h>
+#include <stdatomic.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
+#include "kernel.h"
+#include "palette.h"
+#include "pool.h"
+#include "progressive.h"
+#include "render.h"
+
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb_image_write.h"
 
@@ -16,40 +25,140 @@
 #define INITIAL_SCALE 2.0
 #define INITIAL_RESOLUTION 0.25
 #define INITIAL_ITERATIONS 100
-#define MANDEL_INFINITY 16.0
 #define SPEED 0.5
 
 #define OUTPUT_WIDTH 4000 // 16384
 #define OUTPUT_ITERATIONS 4000
+#define OUTPUT_DEEPEN 5 // Iterations of a deeper image over the last one
+#define OUTPUT_MAX_ITERATIONS 10000000 // T stops here, perturbation keeps ~100 bytes per iteration
 #define OUTPUT_PATH "output.png"
 
-// TODO: Shaders need this to be a float and not double
-typedef float real;
+#define COLOR_THREADS 3 // Workers that colour frames along with the main thread
+#define SHADER_DF_EPSILON 0x1p-48 // A pair of floats keeps about 48 bits
 
-typedef struct {
-    real x;
-    real y;
-} Vector2Real;
+// Shader the GPU path draws with, cheapest first
+typedef enum {
+    SHADER_FLOAT = 0,
+    SHADER_DOUBLE_FLOAT,
+    SHADER_NONE, // Too deep for both, the CPU renders instead
+} ShaderMode;
 
 typedef struct {
     Vector2Real camera;
+    MpVector2 center;
     Vector2Real scale;
+    RenderEngine engine;
+    int iterations;
+    Precision precision;
+    Palette palette;
 } RenderArgs;
 
-real map(real value, real inputStart, real inputEnd, real outputStart, real outputEnd);
-real normalize(real value, real start, real end);
+typedef struct {
+    const float *smooth;
+    const PaletteTable *palette;
+    int iterations; // Limit the smooth counts are coloured against
+    uint8_t *pixels;
+    int width;
+    int comp;
+    int stride; // Every sample covers stride x stride pixels
+} ColorizeJob;
+
+// RGBA copy of the last completed CPU frame, one pixel per sample, uploaded
+// as a single texture. The smooth counts are kept next to it, so a new
+// palette is applied without iterating again.
+typedef struct {
+    uint8_t *pixels;
+    float *smooth;
+    int width;
+    int height;
+    Palette palette; // Palette the pixels are coloured with
+    Texture2D texture;
+    unsigned frame_id;
+    RenderParams params; // View of the frame
+    int stride;
+    RenderStats stats;
+} Framebuffer;
+
+// Counts of the last export, kept so exporting the same view with another
+// palette only colours them again, and its orbits at the limit, so a deeper
+// export of it only carries those on
+typedef struct {
+    int *iters;
+    float *smooth;
+    RenderParams params;
+    RenderStats stats;
+    RenderResume resume;
+} ExportCounts;
+
+ShaderMode shader_mode_for(const RenderParams *view, double slack);
+ShaderMode shader_select(const RenderParams *view, ShaderMode previous);
 real clamp(real value, real min, real max);
-void render_frame(Vector2Real camera, Vector2Real scale, real resolution, int iterations);
-void render_image(Vector2Real camera, Vector2Real scale);
+void camera_move(MpVector2 *center, Vector2Real *camera, real dx, real dy);
+void camera_jump_nucleus(MpVector2 *center, Vector2Real *camera, Vector2Real scale, int iterations);
+void render_frame(Vector2Real camera, const MpVector2 *center, Vector2Real scale, real resolution, int iterations,
+        bool panning);
+void render_image(Vector2Real camera, const MpVector2 *center, Vector2Real scale, int iterations);
 void *render_thread(void *arg);
-void render(Vector2Real camera, Vector2Real scale, real resolution, int iterations, bool realtime);
+void render(Vector2Real camera, const MpVector2 *center, Vector2Real scale, real resolution, int iterations,
+        RenderEngine engine, Precision precision, Palette palette);
+bool export_same_view(const RenderParams *a, const RenderParams *b);
+void colorize_row(void *ctx, int row);
+void framebuffer_resize(Framebuffer *framebuffer, int width, int height);
+void framebuffer_colorize(Framebuffer *framebuffer, Palette palette);
+void framebuffer_free(Framebuffer *framebuffer);
 
 // Globals
-static bool g_rendering_image = false;
+static atomic_bool g_rendering_image = false; // Set until the export thread is done
+static pthread_t g_image_thread;
+static bool g_image_thread_started = false; // And not joined yet
 static int g_rendering_percent = 0;
-
-int main(void)
+static bool g_shader_df = true; // The double-float shader compiled
+static ThreadPool *g_pool = NULL;
+static ThreadPool *g_color_pool = NULL; // The frames of g_pool passes are coloured on this one
+static const EscapeKernels *g_kernels = NULL;
+static RenderEngine g_engine = ENGINE_PIXEL;
+static Precision g_precision = PRECISION_AUTO;
+static Precision g_auto_precision = PRECISION_AUTO; // Last automatic pick of render_frame()
+static RenderParams g_view = { 0 }; // Last view render_frame() asked for
+static double g_bla_epsilon = 0.0;
+static Progressive g_progressive = { 0 };
+static Framebuffer g_framebuffer = { 0 };
+static Palette g_palette = PALETTE_GRAY;
+static PaletteTable g_palette_table = { 0 }; // Of the framebuffer, used on the main thread only
+static ExportCounts g_export = { 0 }; // Only touched by the export thread
+
+int main(int argc, char **argv)
 {
+    // Parse command line arguments
+    int thread_count = pool_default_thread_count();
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            thread_count = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            const char *name = argv[++i];
+            g_precision = PRECISION_COUNT;
+            for (int p = 0; p < PRECISION_COUNT; ++p) {
+                if (strcmp(name, render_precision_name(p)) == 0) g_precision = p;
+            }
+            if (g_precision == PRECISION_COUNT) {
+                fprintf(stderr, "ERROR: Unknown precision '%s'\n", name);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc) {
+            g_bla_epsilon = atof(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [-j threads] [-p auto|float|double|\"long double\"|double-double|fixed-point|perturbation] [-e bla-epsilon]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    g_pool = pool_create(thread_count);
+    g_color_pool = pool_create((thread_count < COLOR_THREADS) ? thread_count : COLOR_THREADS);
+    g_kernels = kernel_select();
+    progressive_start(&g_progressive, g_pool, g_kernels);
+    printf("INFO: Rendering with %d threads using the %s kernel\n",
+            pool_thread_count(g_pool), g_kernels->name);
+
     // Initialize window
     SetConfigFlags(FLAG_WINDOW_RESIZABLE | FLAG_MSAA_4X_HINT);
     InitWindow(WINDOW_WIDTH, WINDOW_HEIGHT, "mandelbrot");
@@ -62,19 +171,39 @@ int main(void)
     int u_scale = GetShaderLocation(shader, "u_Scale");
     int u_iterations = GetShaderLocation(shader, "u_Iterations");
 
+    // Double-float variant for when single precision runs out
+    Shader shader_df = LoadShader("base.vert", "mandelbrot_df.frag");
+    int u_df_resolution = GetShaderLocation(shader_df, "u_Resolution");
+    int u_df_camera_hi = GetShaderLocation(shader_df, "u_CameraHi");
+    int u_df_camera_lo = GetShaderLocation(shader_df, "u_CameraLo");
+    int u_df_scale_hi = GetShaderLocation(shader_df, "u_ScaleHi");
+    int u_df_scale_lo = GetShaderLocation(shader_df, "u_ScaleLo");
+    int u_df_iterations = GetShaderLocation(shader_df, "u_Iterations");
+    // raylib falls back to its default shader, which has none of these
+    // uniforms, when the shader does not compile
+    if (u_df_camera_lo < 0) {
+        g_shader_df = false;
+        fprintf(stderr, "WARNING: The double-float shader needs GL_ARB_gpu_shader5, deep views are rendered on the CPU\n");
+    }
+
     // Screen resolution
     real screen_ratio = (real)WINDOW_HEIGHT / WINDOW_WIDTH;
     Vector2Real screen_size = { WINDOW_WIDTH, WINDOW_HEIGHT };
 
     // Rendering variables
     Vector2Real camera = { -0.5, 0.0 };
+    MpVector2 center; // Camera in full precision, moves go here first
+    render_mp_from_real(&center.x, camera.x);
+    render_mp_from_real(&center.y, camera.y);
     Vector2Real scale = { INITIAL_SCALE, INITIAL_SCALE * screen_ratio };
     real resolution = INITIAL_RESOLUTION;
     int iterations = INITIAL_ITERATIONS;
+    int export_iterations = OUTPUT_ITERATIONS;
 
     // Toggles
     bool debug = true;
     bool gpu = true;
+    ShaderMode shader_mode = SHADER_FLOAT;
 
     while (!WindowShouldClose()) {
         float dt = GetFrameTime();
@@ -100,17 +229,18 @@ int main(void)
         scale.y += -1.0 * GetMouseWheelMove() * SPEED * scale.y;
 
         // Position
+        bool panning = IsKeyDown(KEY_W) || IsKeyDown(KEY_A) || IsKeyDown(KEY_S) || IsKeyDown(KEY_D);
         if (IsKeyDown(KEY_W)) {
-            camera.y -= SPEED * scale.y * dt;
+            camera_move(&center, &camera, 0, -SPEED * scale.y * dt);
         }
         if (IsKeyDown(KEY_A)) {
-            camera.x -= SPEED * scale.x * dt;
+            camera_move(&center, &camera, -SPEED * scale.x * dt, 0);
         }
         if (IsKeyDown(KEY_S)) {
-            camera.y += SPEED * scale.y * dt;
+            camera_move(&center, &camera, 0, SPEED * scale.y * dt);
         }
         if (IsKeyDown(KEY_D)) {
-            camera.x += SPEED * scale.x * dt;
+            camera_move(&center, &camera, SPEED * scale.x * dt, 0);
         }
 
         // Resolution
@@ -131,9 +261,20 @@ int main(void)
             if (iterations < 0) iterations = 0;
         }
 
+        // Nearest minibrot
+        if (IsKeyPressed(KEY_N)) {
+            camera_jump_nucleus(&center, &camera, scale, iterations);
+        }
+
         // Image rendering
-        if (IsKeyPressed(KEY_R) && !g_rendering_image) {
-            render_image(camera, scale);
+        if (IsKeyPressed(KEY_R) && !atomic_load(&g_rendering_image)) {
+            export_iterations = OUTPUT_ITERATIONS;
+            render_image(camera, &center, scale, export_iterations);
+        }
+        if (IsKeyPressed(KEY_T) && !atomic_load(&g_rendering_image)) {
+            export_iterations = (export_iterations <= OUTPUT_MAX_ITERATIONS / OUTPUT_DEEPEN)
+                ? export_iterations * OUTPUT_DEEPEN : OUTPUT_MAX_ITERATIONS;
+            render_image(camera, &center, scale, export_iterations);
         }
 
         // Toggles
@@ -143,23 +284,67 @@ int main(void)
         if (IsKeyPressed(KEY_G)) {
             gpu = !gpu;
         }
+        if (IsKeyPressed(KEY_E)) {
+            g_engine = (g_engine + 1) % ENGINE_COUNT;
+        }
+        if (IsKeyPressed(KEY_P)) {
+            g_precision = (g_precision + 1) % PRECISION_COUNT;
+        }
+        if (IsKeyPressed(KEY_C)) {
+            g_palette = (g_palette + 1) % PALETTE_COUNT;
+        }
 
         /* Rendering */
 
         BeginDrawing();
         ClearBackground(BLACK);
 
-        // Draw Mandelbrot set
+        // Draw Mandelbrot set. The GPU draws as long as one of its shaders
+        // resolves a pixel, by the same test the CPU uses to pick its
+        // precision, and hands deeper views to the CPU.
         if (gpu) {
-            BeginShaderMode(shader);
-            SetShaderValue(shader, u_resolution, &screen_size, SHADER_UNIFORM_VEC2);
-            SetShaderValue(shader, u_camera, &camera, SHADER_UNIFORM_VEC2);
-            SetShaderValue(shader, u_scale, &scale, SHADER_UNIFORM_VEC2);
-            SetShaderValue(shader, u_iterations, &iterations, SHADER_UNIFORM_INT);
+            RenderParams view = {
+                .camera = camera,
+                .scale = scale,
+                .width = width,
+                .height = height,
+                .pixel_width = 1,
+                .pixel_height = 1,
+                .iterations = iterations,
+                .precision = PRECISION_AUTO,
+            };
+            shader_mode = shader_select(&view, shader_mode);
+        }
+        bool on_gpu = gpu && shader_mode != SHADER_NONE;
+
+        if (on_gpu) {
+            Vector2 shader_resolution = { screen_size.x, screen_size.y };
+            Vector2 shader_camera = { camera.x, camera.y };
+            Vector2 shader_scale = { scale.x, scale.y };
+
+            if (shader_mode == SHADER_DOUBLE_FLOAT) {
+                // Split into the nearest floats and what they leave out
+                Vector2 shader_camera_lo = { camera.x - shader_camera.x, camera.y - shader_camera.y };
+                Vector2 shader_scale_lo = { scale.x - shader_scale.x, scale.y - shader_scale.y };
+
+                BeginShaderMode(shader_df);
+                SetShaderValue(shader_df, u_df_resolution, &shader_resolution, SHADER_UNIFORM_VEC2);
+                SetShaderValue(shader_df, u_df_camera_hi, &shader_camera, SHADER_UNIFORM_VEC2);
+                SetShaderValue(shader_df, u_df_camera_lo, &shader_camera_lo, SHADER_UNIFORM_VEC2);
+                SetShaderValue(shader_df, u_df_scale_hi, &shader_scale, SHADER_UNIFORM_VEC2);
+                SetShaderValue(shader_df, u_df_scale_lo, &shader_scale_lo, SHADER_UNIFORM_VEC2);
+                SetShaderValue(shader_df, u_df_iterations, &iterations, SHADER_UNIFORM_INT);
+            } else {
+                BeginShaderMode(shader);
+                SetShaderValue(shader, u_resolution, &shader_resolution, SHADER_UNIFORM_VEC2);
+                SetShaderValue(shader, u_camera, &shader_camera, SHADER_UNIFORM_VEC2);
+                SetShaderValue(shader, u_scale, &shader_scale, SHADER_UNIFORM_VEC2);
+                SetShaderValue(shader, u_iterations, &iterations, SHADER_UNIFORM_INT);
+            }
             DrawRectangle(0, 0, width, height, WHITE);
             EndShaderMode();
         } else {
-            render_frame(camera, scale, resolution, iterations);
+            render_frame(camera, &center, scale, resolution, iterations, panning);
         }
 
         // Debug info text
@@ -167,12 +352,32 @@ int main(void)
             int i = 0;
             DrawText(TextFormat("FPS: %d", GetFPS()), 10, 10 + 20*(i++), FONT_SIZE, GREEN);
             DrawText(TextFormat("Iterations: %i", iterations), 10, 10 + 20*(i++), FONT_SIZE, GREEN);
-            DrawText(TextFormat("Resolution: %f", (gpu ? 1.0 : resolution)), 10, 10 + 20*(i++), FONT_SIZE, GREEN);
-            DrawText(TextFormat("Scale: (%f, %f)", scale.x, scale.y), 10, 10 + 20*(i++), FONT_SIZE, GREEN);
-            DrawText(TextFormat("Camera: (%f, %f)", camera.x, -camera.y), 10, 10 + 20*(i++), FONT_SIZE, GREEN);
-            DrawText(TextFormat("Rendering mode: %s", (gpu ? "GPU" : "CPU")), 10, 10 + 20*(i++), FONT_SIZE, GREEN);
+            DrawText(TextFormat("Resolution: %f", (double)(on_gpu ? 1.0 : resolution / (g_framebuffer.stride > 0 ? g_framebuffer.stride : 1))), 10, 10 + 20*(i++), FONT_SIZE, GREEN);
+            DrawText(TextFormat("Scale: (%g, %g)", (double)scale.x, (double)scale.y), 10, 10 + 20*(i++), FONT_SIZE, GREEN);
+            DrawText(TextFormat("Camera: (%.17g, %.17g)", (double)camera.x, (double)-camera.y), 10, 10 + 20*(i++), FONT_SIZE, GREEN);
+            const char *engine = render_precision_name(g_framebuffer.stats.precision);
+            if (on_gpu) engine = (shader_mode == SHADER_DOUBLE_FLOAT) ? "double-float" : "float";
+            DrawText(TextFormat("Rendering mode: %s (%s)", (on_gpu ? "GPU" : "CPU"), engine),
+                    10, 10 + 20*(i++), FONT_SIZE, GREEN);
+            if (!on_gpu) {
+                RenderStats stats = g_framebuffer.stats;
+                double iterated = (stats.samples > 0) ? (double)stats.iterated / stats.samples * 100.0 : 0.0;
+                DrawText(TextFormat("Engine: %s", render_engine_name(g_engine)), 10, 10 + 20*(i++), FONT_SIZE, GREEN);
+                DrawText(TextFormat("Precision: %s%s", render_precision_name(stats.precision),
+                            (g_precision == PRECISION_AUTO ? " (auto)" : "")), 10, 10 + 20*(i++), FONT_SIZE, GREEN);
+                DrawText(TextFormat("Iterated: %.1f%%", iterated), 10, 10 + 20*(i++), FONT_SIZE, GREEN);
+                DrawText(TextFormat("Interior skipped: %ld", stats.interior_skipped), 10, 10 + 20*(i++), FONT_SIZE, GREEN);
+                DrawText(TextFormat("Mirrored: %ld", stats.mirrored), 10, 10 + 20*(i++), FONT_SIZE, GREEN);
+                DrawText(TextFormat("Palette: %s", palette_name(g_palette)), 10, 10 + 20*(i++), FONT_SIZE, GREEN);
+                if (stats.resumed > 0) {
+                    DrawText(TextFormat("Carried on: %ld", stats.resumed), 10, 10 + 20*(i++), FONT_SIZE, GREEN);
+                }
+                if (stats.precision == PRECISION_PERTURBATION && stats.nucleus_period > 0) {
+                    DrawText(TextFormat("Reference: period %d nucleus", stats.nucleus_period), 10, 10 + 20*(i++), FONT_SIZE, GREEN);
+                }
+            }
         }
-        if (g_rendering_image) {
+        if (atomic_load(&g_rendering_image)) {
             const char *text = "Rendering "OUTPUT_PATH" (Saving)";
             if (g_rendering_percent != -1) {
                 text = TextFormat("Rendering "OUTPUT_PATH" (%d%%)", g_rendering_percent);
@@ -187,23 +392,33 @@ int main(void)
 
     // Cleanup
     UnloadShader(shader);
+    UnloadShader(shader_df);
     CloseWindow();
+    framebuffer_free(&g_framebuffer);
+    progressive_stop(&g_progressive);
+    // An export in flight still uses the pool
+    if (g_image_thread_started) pthread_join(g_image_thread, NULL);
+    pool_destroy(g_pool);
+    pool_destroy(g_color_pool);
 
     return EXIT_SUCCESS;
 }
 
-real map(real value, real inputStart, real inputEnd, real outputStart, real outputEnd)
+ShaderMode shader_mode_for(const RenderParams *view, double slack)
 {
-    real result = (value - inputStart)/(inputEnd - inputStart)*(outputEnd - outputStart) + outputStart;
-
-    return result;
+    if (render_precision_resolves(view, FLT_EPSILON, slack)) return SHADER_FLOAT;
+    if (g_shader_df && render_precision_resolves(view, SHADER_DF_EPSILON, slack)) return SHADER_DOUBLE_FLOAT;
+    return SHADER_NONE;
 }
 
-real normalize(real value, real start, real end)
+// Cheapest shader for the view, with the hysteresis of the CPU precision
+ShaderMode shader_select(const RenderParams *view, ShaderMode previous)
 {
-    real result = (value - start)/(end - start);
+    ShaderMode needed = shader_mode_for(view, 1.0);
+    if (needed >= previous) return needed;
 
-    return result;
+    ShaderMode relaxed = shader_mode_for(view, PRECISION_HYSTERESIS);
+    return (relaxed < previous) ? relaxed : previous;
 }
 
 real clamp(real value, real min, real max)
@@ -215,35 +430,154 @@ real clamp(real value, real min, real max)
     return result;
 }
 
-void render_frame(Vector2Real camera, Vector2Real scale, real resolution, int iterations)
+// Pans the full precision centre, `camera` follows as the nearest real. A
+// real camera alone stops moving once a step is below its last bit.
+void camera_move(MpVector2 *center, Vector2Real *camera, real dx, real dy)
+{
+    MpFixed delta;
+
+    render_mp_from_real(&delta, dx);
+    mp_add(&center->x, &center->x, &delta, MP_MAX_LIMBS);
+    render_mp_from_real(&delta, dy);
+    mp_add(&center->y, &center->y, &delta, MP_MAX_LIMBS);
+    camera->x = render_real_from_mp(&center->x);
+    camera->y = render_real_from_mp(&center->y);
+}
+
+// Centres the view on the nucleus of lowest period in it
+void camera_jump_nucleus(MpVector2 *center, Vector2Real *camera, Vector2Real scale, int iterations)
+{
+    RenderParams view = {
+        .camera = *camera,
+        .scale = scale,
+        .has_center = true,
+        .center = *center,
+        .width = GetScreenWidth(),
+        .height = GetScreenHeight(),
+        .pixel_width = 1,
+        .pixel_height = 1,
+        .iterations = iterations,
+    };
+
+    MpVector2 nucleus;
+    int period;
+    if (!render_nucleus(&view, &nucleus, &period)) {
+        printf("INFO: No minibrot found in view within %d iterations\n", iterations);
+        return;
+    }
+
+    *center = nucleus;
+    camera->x = render_real_from_mp(&center->x);
+    camera->y = render_real_from_mp(&center->y);
+    printf("INFO: Jumped to the nucleus of period %d\n", period);
+}
+
+void render_frame(Vector2Real camera, const MpVector2 *center, Vector2Real scale, real resolution, int iterations,
+        bool panning)
 {
-    render(camera, scale, resolution, iterations, true);
+    int width = GetScreenWidth();
+    int height = GetScreenHeight();
+
+    RenderParams params = {
+        .camera = camera,
+        .scale = scale,
+        .has_center = true,
+        .center = *center,
+        .width = width,
+        .height = height,
+        .pixel_width = width / (width * resolution),
+        .pixel_height = height / (height * resolution),
+        .iterations = iterations,
+        .engine = g_engine,
+        .precision = g_precision,
+        .bla_epsilon = g_bla_epsilon,
+        .symmetry = true,
+        .reference_nucleus = true,
+    };
+    if (g_precision == PRECISION_AUTO) {
+        params.precision = render_select_precision_from(g_kernels, &params, g_auto_precision);
+        g_auto_precision = params.precision;
+    }
+
+    // While panning the view keeps to the sample grid of the last one, so
+    // only the strips that come into view are rendered. The camera itself
+    // moves freely, the view catches up with it once panning stops.
+    if (panning && render_same_spacing(&g_view, &params)) {
+        long double columns, rows;
+        render_grid_offset(&g_view, &params, &columns, &rows);
+        real step_x = 2 * scale.x * params.pixel_width / width;
+        real step_y = 2 * scale.y * params.pixel_height / height;
+        params.center = g_view.center;
+        camera_move(&params.center, &params.camera, roundl(columns) * step_x, roundl(rows) * step_y);
+    }
+    g_view = params;
+    progressive_request(&g_progressive, &params);
+
+    // Show the last completed frame, which may still be of a previous view
+    const ProgressiveFrame *frame = progressive_acquire(&g_progressive, g_framebuffer.frame_id);
+    if (frame != NULL) {
+        int columns = render_columns(&frame->params);
+        int rows = render_rows(&frame->params);
+        framebuffer_resize(&g_framebuffer, columns, rows);
+        memcpy(g_framebuffer.smooth, frame->smooth, columns * rows * sizeof(*g_framebuffer.smooth));
+
+        g_framebuffer.frame_id = frame->id;
+        g_framebuffer.params = frame->params;
+        g_framebuffer.stride = frame->stride;
+        g_framebuffer.stats = frame->stats;
+        progressive_release(&g_progressive);
+
+        framebuffer_colorize(&g_framebuffer, g_palette);
+    } else if (g_framebuffer.pixels != NULL && g_framebuffer.palette != g_palette) {
+        framebuffer_colorize(&g_framebuffer, g_palette);
+    }
+    if (g_framebuffer.pixels == NULL) return;
+
+    Rectangle source = { 0, 0, g_framebuffer.width, g_framebuffer.height };
+    Rectangle dest = {
+        0, 0,
+        g_framebuffer.width * g_framebuffer.params.pixel_width,
+        g_framebuffer.height * g_framebuffer.params.pixel_height,
+    };
+    DrawTexturePro(g_framebuffer.texture, source, dest, (Vector2){ 0, 0 }, 0.0, WHITE);
 }
 
-void render_image(Vector2Real camera, Vector2Real scale)
+void render_image(Vector2Real camera, const MpVector2 *center, Vector2Real scale, int iterations)
 {
     RenderArgs *args = malloc(sizeof(*args));
     assert(args != NULL);
     args->camera = camera;
+    args->center = *center;
     args->scale = scale;
-
-    pthread_t tid;
-    if (pthread_create(&tid, NULL, render_thread, args) != 0) {
+    args->engine = g_engine;
+    args->iterations = iterations;
+    args->precision = g_precision;
+    args->palette = g_palette;
+
+    // Marked busy before the thread starts, so no second export can start
+    // on the shared export state in the meantime
+    atomic_store(&g_rendering_image, true);
+    if (g_image_thread_started) pthread_join(g_image_thread, NULL); // Already done
+    g_image_thread_started = pthread_create(&g_image_thread, NULL, render_thread, args) == 0;
+    if (!g_image_thread_started) {
         fprintf(stderr, "ERROR: Could not create the image rendering thread\n");
+        atomic_store(&g_rendering_image, false);
+        free(args);
     }
 }
 
 void *render_thread(void *arg)
 {
     RenderArgs *args = (RenderArgs*)arg;
-    g_rendering_image = true;
-    render(args->camera, args->scale, 1.0, OUTPUT_ITERATIONS, false);
-    g_rendering_image = false;
+    render(args->camera, &args->center, args->scale, 1.0, args->iterations, args->engine, args->precision,
+            args->palette);
     free(args);
+    atomic_store(&g_rendering_image, false);
     return NULL;
 }
 
-void render(Vector2Real camera, Vector2Real scale, real resolution, int iterations, bool realtime)
+void render(Vector2Real camera, const MpVector2 *center, Vector2Real scale, real resolution, int iterations,
+        RenderEngine engine, Precision precision, Palette palette)
 {
     int width;
     int height;
@@ -254,87 +588,228 @@ void render(Vector2Real camera, Vector2Real scale, real resolution, int iteratio
     int comp = 3;
     uint8_t *pixels = NULL;
 
-    if (realtime) {
-        width = GetScreenWidth();
-        height = GetScreenHeight();
-    } else {
-        clock_gettime(CLOCK_MONOTONIC, &start);
+    clock_gettime(CLOCK_MONOTONIC, &start);
 
-        real screen_ratio = (real)GetScreenHeight() / GetScreenWidth();
-        width = OUTPUT_WIDTH;
-        height = width * screen_ratio;
-
-        pixels = malloc(width * height * comp * sizeof(*pixels));
-        assert(pixels != NULL);
-    }
+    real screen_ratio = (real)GetScreenHeight() / GetScreenWidth();
+    width = OUTPUT_WIDTH;
+    height = width * screen_ratio;
 
     pixel_width = width / (width * resolution);
     pixel_height = height / (height * resolution);
 
-    for (int y = 0; y < height; y += pixel_height) {
-        if (!realtime) {
-            g_rendering_percent = (real)y / height * 100.0;
-        }
-
-        for (int x = 0; x < width; x += pixel_width) {
-            real z_real = map(x, 0, width,  camera.x - scale.x, camera.x + scale.x);
-            real z_imag = map(y, 0, height, camera.y - scale.y, camera.y + scale.y);
-            real c_real = z_real;
-            real c_imag = z_imag;
-
-            int i;
-            for (i = 0; i < iterations; ++i) {
-                real new_z_real = z_real*z_real - z_imag*z_imag;
-                real new_z_imag = 2*z_real*z_imag;
-
-                z_real = new_z_real + c_real;
-                z_imag = new_z_imag + c_imag;
-
-                if (fabs(z_real + z_imag) > MANDEL_INFINITY) {
-                    break;
-                }
+    RenderParams params = {
+        .camera = camera,
+        .scale = scale,
+        .has_center = true,
+        .center = *center,
+        .width = width,
+        .height = height,
+        .pixel_width = pixel_width,
+        .pixel_height = pixel_height,
+        .iterations = iterations,
+        .engine = engine,
+        .precision = precision,
+        .bla_epsilon = g_bla_epsilon,
+        .symmetry = true,
+        .cache_reference = true,
+        .reference_nucleus = true,
+        .progress = &g_rendering_percent,
+    };
+    int columns = render_columns(&params);
+    int rows = render_rows(&params);
+
+    // The same view again only takes new colours, and at a higher limit
+    // only carries on the samples at the old one
+    RenderParams raised = g_export.params;
+    raised.iterations = iterations;
+    bool recolor = g_export.iters != NULL && export_same_view(&g_export.params, &params);
+    bool deepen = g_export.iters != NULL && iterations > g_export.params.iterations
+        && export_same_view(&raised, &params);
+    int from = g_export.params.iterations;
+    if (!recolor) {
+        if (!deepen) {
+            free(g_export.iters);
+            free(g_export.smooth);
+            g_export.iters = malloc(columns * rows * sizeof(*g_export.iters));
+            g_export.smooth = malloc(columns * rows * sizeof(*g_export.smooth));
+            render_resume_clear(&g_export.resume);
+            if (g_export.iters == NULL || g_export.smooth == NULL) {
+                fprintf(stderr, "ERROR: Could not allocate the counts of a %dx%d image\n", columns, rows);
+                free(g_export.iters);
+                free(g_export.smooth);
+                g_export.iters = NULL;
+                g_export.smooth = NULL;
+                return;
             }
+        }
+        g_export.params = params;
+        params.resume = &g_export.resume;
+        params.smooth = g_export.smooth;
+        render_iterations(g_pool, g_kernels, &params, g_export.iters, &g_export.stats);
+    }
+    RenderStats stats = g_export.stats;
 
-            Color color = BLACK;
-            if (i != iterations) {
-                real norm = normalize(i, 0.0, iterations);
-                real bright = sqrt(norm) * 255;
-                color = (Color){ bright, bright, bright, 255 };
-            }
+    pixels = malloc(width * height * comp * sizeof(*pixels));
+    if (pixels == NULL) {
+        fprintf(stderr, "ERROR: Could not allocate the pixels of a %dx%d image\n", width, height);
+        return;
+    }
 
-            if (realtime) {
-                DrawRectangle(x, y, pixel_width, pixel_height, color);
-            } else {
-                int pix = (x + y*width) * comp;
-                pixels[pix + 0] = color.r;
-                pixels[pix + 1] = color.g;
-                pixels[pix + 2] = color.b;
+    PaletteTable table = { 0 };
+    palette_build(&table, palette);
+    ColorizeJob job = {
+        .smooth = g_export.smooth,
+        .palette = &table,
+        .iterations = iterations,
+        .pixels = pixels,
+        .width = width,
+        .comp = comp,
+        .stride = 1,
+    };
+    pool_run(g_pool, height, colorize_row, &job);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    long delta_us = (end.tv_sec - start.tv_sec) * 1000000 + (end.tv_nsec -
+            start.tv_nsec) / 1000;
+    long ms = delta_us / 1000;
+
+    if (recolor) {
+        printf("INFO: Recolouring the last render with the %s palette took %ldms\n", palette_name(palette), ms);
+    } else if (deepen) {
+        printf("INFO: Deepening the last render from %d to %d iterations took %ldms\n", from, iterations, ms);
+        printf("INFO: %ld pixels were carried on in %s precision\n", stats.resumed,
+                render_precision_name(stats.precision));
+    } else {
+        printf("INFO: Rendering took %ldms\n", ms);
+        if (stats.orbit_hits + stats.orbit_extended + stats.orbit_misses > 0) {
+            printf("INFO: Reference orbit cache: %ld hits, %ld extended, %ld misses\n",
+                    stats.orbit_hits, stats.orbit_extended, stats.orbit_misses);
+        }
+        printf("INFO: %s engine iterated %.1f%% of the pixels in %s precision, %ld were inside the main cardioid and bulb, %ld were mirrored\n",
+                render_engine_name(engine), (double)stats.iterated / stats.samples * 100.0,
+                render_precision_name(stats.precision),
+                stats.interior_skipped, stats.mirrored);
+        if (stats.precision == PRECISION_PERTURBATION) {
+            printf("INFO: %ld pixels were glitched, %ld of them corrected with extra references\n",
+                    stats.glitched, stats.corrected);
+            if (stats.nucleus_period > 0) {
+                printf("INFO: The reference orbit starts on the nucleus of period %d\n", stats.nucleus_period);
             }
         }
     }
 
-    if (!realtime) {
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    g_rendering_percent = -1;
+    int res = stbi_write_png(OUTPUT_PATH, width, height, comp, pixels, width * comp);
+    if (res == 0) {
+        fprintf(stderr, "ERROR: Could not render output image\n");
+    } else {
         clock_gettime(CLOCK_MONOTONIC, &end);
-        long delta_us = (end.tv_sec - start.tv_sec) * 1000000 + (end.tv_nsec -
+        delta_us = (end.tv_sec - start.tv_sec) * 1000000 + (end.tv_nsec -
                 start.tv_nsec) / 1000;
-        long ms = delta_us / 1000;
+        ms = delta_us / 1000;
+        printf("INFO: Saving took %ldms\n", ms);
+    }
 
-        printf("INFO: Rendering took %ldms\n", ms);
+    free(pixels);
+}
 
-        clock_gettime(CLOCK_MONOTONIC, &start);
+// Whether two exports iterate the same samples the same way
+bool export_same_view(const RenderParams *a, const RenderParams *b)
+{
+    return a->has_center == b->has_center
+        && mp_equal(&a->center.x, &b->center.x, MP_MAX_LIMBS) && mp_equal(&a->center.y, &b->center.y, MP_MAX_LIMBS)
+        && a->camera.x == b->camera.x && a->camera.y == b->camera.y
+        && a->scale.x == b->scale.x && a->scale.y == b->scale.y
+        && a->width == b->width && a->height == b->height
+        && a->pixel_width == b->pixel_width && a->pixel_height == b->pixel_height
+        && a->iterations == b->iterations && a->engine == b->engine && a->precision == b->precision
+        && a->bla_epsilon == b->bla_epsilon;
+}
 
-        g_rendering_percent = -1;
-        int res = stbi_write_png(OUTPUT_PATH, width, height, comp, pixels, width * comp);
-        if (res == 0) {
-            fprintf(stderr, "ERROR: Could not render output image\n");
-        } else {
-            clock_gettime(CLOCK_MONOTONIC, &end);
-            delta_us = (end.tv_sec - start.tv_sec) * 1000000 + (end.tv_nsec -
-                    start.tv_nsec) / 1000;
-            ms = delta_us / 1000;
-            printf("INFO: Saving took %ldms\n", ms);
+void colorize_row(void *ctx, int row)
+{
+    ColorizeJob *job = (ColorizeJob*)ctx;
+    const float *samples = &job->smooth[(row - row % job->stride) * job->width];
+    const uint8_t *table = job->palette->rgba;
+    float scale = (float)PALETTE_SIZE / job->iterations;
+
+    for (int x = 0; x < job->width; ++x) {
+        float s = samples[x - x % job->stride];
+        uint8_t *pixel = &job->pixels[(x + row*job->width) * job->comp];
+
+        // The limit (and anything past it) stays black
+        if (s >= job->iterations) {
+            for (int c = 0; c < job->comp; ++c) pixel[c] = (c == 3) ? 255 : 0;
+            continue;
         }
 
-        free(pixels);
+        // Blend the two entries around the smooth count
+        float position = (s > 0.0f) ? s * scale : 0.0f;
+        int i = (position < PALETTE_SIZE) ? (int)position : PALETTE_SIZE - 1;
+        float t = position - i;
+        const uint8_t *color = &table[4 * i];
+        const uint8_t *next = &table[4 * (i + 1)];
+        for (int c = 0; c < job->comp; ++c) {
+            pixel[c] = (uint8_t)(color[c] + (next[c] - color[c]) * t + 0.5f);
+        }
     }
 }
+
+// Reallocates the pixels and the texture when the size changes
+void framebuffer_resize(Framebuffer *framebuffer, int width, int height)
+{
+    if (framebuffer->pixels != NULL && framebuffer->width == width && framebuffer->height == height) {
+        return;
+    }
+
+    framebuffer_free(framebuffer);
+    framebuffer->pixels = calloc(width * height * 4, sizeof(*framebuffer->pixels));
+    framebuffer->smooth = malloc(width * height * sizeof(*framebuffer->smooth));
+    assert(framebuffer->pixels != NULL && framebuffer->smooth != NULL);
+    framebuffer->width = width;
+    framebuffer->height = height;
+
+    Image image = {
+        .data = framebuffer->pixels,
+        .width = width,
+        .height = height,
+        .mipmaps = 1,
+        .format = PIXELFORMAT_UNCOMPRESSED_R8G8B8A8,
+    };
+    framebuffer->texture = LoadTextureFromImage(image);
+}
+
+void framebuffer_free(Framebuffer *framebuffer)
+{
+    if (framebuffer->pixels == NULL) return;
+
+    UnloadTexture(framebuffer->texture);
+    free(framebuffer->pixels);
+    free(framebuffer->smooth);
+    framebuffer->pixels = NULL;
+    framebuffer->smooth = NULL;
+}
+
+// Colours the kept counts and uploads them. Every sample of the frame covers
+// a block of stride x stride samples. Colouring runs on its own pool, a
+// thread that helps out on g_pool could pick up a tile of the next pass.
+void framebuffer_colorize(Framebuffer *framebuffer, Palette palette)
+{
+    palette_build(&g_palette_table, palette);
+
+    ColorizeJob job = {
+        .smooth = framebuffer->smooth,
+        .palette = &g_palette_table,
+        .iterations = framebuffer->params.iterations,
+        .pixels = framebuffer->pixels,
+        .width = framebuffer->width,
+        .comp = 4,
+        .stride = framebuffer->stride,
+    };
+    pool_run(g_color_pool, framebuffer->height, colorize_row, &job);
+    framebuffer->palette = palette;
+
+    UpdateTexture(framebuffer->texture, framebuffer->pixels);
+}
@@ -32,6 +32,21 @@ vec2 square_complex(vec2 c)
     );
 }
 
+// Points inside the main cardioid or the period-2 bulb never escape
+bool inside_main_bulbs(vec2 c)
+{
+    float ci2 = c.y * c.y;
+
+    float x = c.x - 0.25;
+    float q = x * x + ci2;
+    if (q * (q + x) <= 0.25 * ci2) {
+        return true;
+    }
+
+    float y = c.x + 1.0;
+    return y * y + ci2 <= 0.0625;
+}
+
 int inside_mandelbrot_set(vec2 point)
 {
     vec2 z = vec2(
@@ -40,6 +55,10 @@ int inside_mandelbrot_set(vec2 point)
     );
     vec2 c = z;
 
+    if (inside_main_bulbs(c)) {
+        return u_Iterations;
+    }
+
     int i;
     for (i = 0; i < u_Iterations; ++i) {
         z = square_complex(z) + c;
@@ -0,0 +1,147 @@
+#version 330
+#extension GL_ARB_gpu_shader5 : enable
+
+#define MANDEL_INFINITY 16.0
+
+// The error terms below are algebraically zero, so the compiler must not be
+// allowed to reassociate or fuse them away. Without `precise` they are, and
+// the shader is no better than float, so it refuses to compile and the
+// viewer renders deep views on the CPU instead.
+#ifdef GL_ARB_gpu_shader5
+#define PRECISE precise
+#else
+#error "mandelbrot_df.frag needs GL_ARB_gpu_shader5"
+#endif
+
+// Variant of mandelbrot.frag for deep zooms. Every coordinate is a
+// double-float: the unevaluated sum hi + lo of two floats (stored as a vec2),
+// which carries about 48 bits of mantissa. The camera and the scale come in
+// already split into their hi and lo parts.
+
+// Input vertex attributes (from vertex shader)
+in vec2 fragTexCoord;
+in vec4 fragColor;
+
+// Input uniform values
+uniform sampler2D texture0;
+uniform vec4 colDiffuse;
+
+// Output fragment color
+out vec4 finalColor;
+
+uniform vec2 u_Resolution;
+uniform vec2 u_CameraHi;
+uniform vec2 u_CameraLo;
+uniform vec2 u_ScaleHi;
+uniform vec2 u_ScaleLo;
+uniform int u_Iterations;
+
+vec2 df_two_sum(float a, float b)
+{
+    PRECISE float s = a + b;
+    PRECISE float bb = s - a;
+    PRECISE float e = (a - (s - bb)) + (b - bb);
+    return vec2(s, e);
+}
+
+// Only exact when |a| >= |b|
+vec2 df_quick_two_sum(float a, float b)
+{
+    PRECISE float s = a + b;
+    PRECISE float e = b - (s - a);
+    return vec2(s, e);
+}
+
+// Dekker's splitting. fma() would be shorter but is not guaranteed to
+// round once, llvmpipe for one computes it as a separate multiply and add.
+vec2 df_split(float a)
+{
+    PRECISE float t = 4097.0 * a; // 2^12 + 1
+    PRECISE float hi = t - (t - a);
+    PRECISE float lo = a - hi;
+    return vec2(hi, lo);
+}
+
+vec2 df_two_prod(float a, float b)
+{
+    PRECISE float p = a * b;
+    vec2 as = df_split(a);
+    vec2 bs = df_split(b);
+    PRECISE float e = ((as.x * bs.x - p) + as.x * bs.y + as.y * bs.x) + as.y * bs.y;
+    return vec2(p, e);
+}
+
+vec2 df_add(vec2 a, vec2 b)
+{
+    vec2 s = df_two_sum(a.x, b.x);
+    PRECISE float e = s.y + (a.y + b.y);
+    return df_quick_two_sum(s.x, e);
+}
+
+vec2 df_mul(vec2 a, vec2 b)
+{
+    vec2 p = df_two_prod(a.x, b.x);
+    PRECISE float e = p.y + (a.x * b.y + a.y * b.x);
+    return df_quick_two_sum(p.x, e);
+}
+
+// Points inside the main cardioid or the period-2 bulb never escape
+bool inside_main_bulbs(vec2 c)
+{
+    float ci2 = c.y * c.y;
+
+    float x = c.x - 0.25;
+    float q = x * x + ci2;
+    if (q * (q + x) <= 0.25 * ci2) {
+        return true;
+    }
+
+    float y = c.x + 1.0;
+    return y * y + ci2 <= 0.0625;
+}
+
+int inside_mandelbrot_set(vec2 point)
+{
+    // c = camera + scale * offset, offset going from -1 to 1 over the screen
+    vec2 offset = 2.0 * point / u_Resolution - 1.0;
+    vec2 c_real = df_add(vec2(u_CameraHi.x, u_CameraLo.x), df_mul(vec2(u_ScaleHi.x, u_ScaleLo.x), vec2(offset.x, 0.0)));
+    vec2 c_imag = df_add(vec2(u_CameraHi.y, u_CameraLo.y), df_mul(vec2(u_ScaleHi.y, u_ScaleLo.y), vec2(offset.y, 0.0)));
+
+    if (inside_main_bulbs(vec2(c_real.x, c_imag.x))) {
+        return u_Iterations;
+    }
+
+    vec2 z_real = c_real;
+    vec2 z_imag = c_imag;
+
+    int i;
+    for (i = 0; i < u_Iterations; ++i) {
+        vec2 z_real2 = df_mul(z_real, z_real);
+        vec2 z_imag2 = df_mul(z_imag, z_imag);
+        vec2 z_cross = df_mul(z_real, z_imag);
+
+        z_real = df_add(df_add(z_real2, -z_imag2), c_real);
+        z_imag = df_add(2.0 * z_cross, c_imag);
+
+        if (abs(z_real.x + z_imag.x) > MANDEL_INFINITY) {
+            return i;
+        }
+    }
+
+    return i;
+}
+
+void main()
+{
+    vec2 pixel = gl_FragCoord.xy;
+    pixel.y = u_Resolution.y - pixel.y; // Flip y coord
+
+    int iters = inside_mandelbrot_set(pixel);
+    if (iters == u_Iterations) {
+        finalColor = vec4(0.0, 0.0, 0.0, 1.0);
+    } else {
+        float norm = float(iters) / float(u_Iterations);
+        float bright = sqrt(norm);
+        finalColor = vec4(bright, bright, bright, 1.0);
+    }
+}
@@ -0,0 +1,344 @@
+#include "mp.h"
+
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+typedef unsigned __int128 MpWide;
+
+// Karatsuba needs 4(l + 1) limbs per level with l = ceil(n/2), this bounds
+// the sum over all levels
+#define MP_SCRATCH_LIMBS (8*MP_MAX_LIMBS)
+
+static inline uint64_t *mp_top(MpFixed *a, int n)
+{
+    return &a->limb[MP_MAX_LIMBS - n];
+}
+
+static inline const uint64_t *mp_top_const(const MpFixed *a, int n)
+{
+    return &a->limb[MP_MAX_LIMBS - n];
+}
+
+/* Magnitudes: little-endian limb arrays */
+
+static int mag_cmp(const uint64_t *a, const uint64_t *b, int n)
+{
+    for (int i = n - 1; i >= 0; --i) {
+        if (a[i] != b[i]) return (a[i] < b[i]) ? -1 : 1;
+    }
+
+    return 0;
+}
+
+static bool mag_is_zero(const uint64_t *a, int n)
+{
+    for (int i = 0; i < n; ++i) {
+        if (a[i] != 0) return false;
+    }
+
+    return true;
+}
+
+static uint64_t mag_add(uint64_t *r, const uint64_t *a, const uint64_t *b, int n)
+{
+    uint64_t carry = 0;
+    for (int i = 0; i < n; ++i) {
+        MpWide t = (MpWide)a[i] + b[i] + carry;
+        r[i] = (uint64_t)t;
+        carry = (uint64_t)(t >> 64);
+    }
+
+    return carry;
+}
+
+// a >= b
+static void mag_sub(uint64_t *r, const uint64_t *a, const uint64_t *b, int n)
+{
+    uint64_t borrow = 0;
+    for (int i = 0; i < n; ++i) {
+        uint64_t d = a[i] - b[i];
+        uint64_t next = (a[i] < b[i]) || (d < borrow);
+        r[i] = d - borrow;
+        borrow = next;
+    }
+}
+
+// r[0, rn) += x[0, xn), the carry runs up to rn and past that is dropped
+static void mag_add_into(uint64_t *r, int rn, const uint64_t *x, int xn)
+{
+    uint64_t carry = 0;
+    int i = 0;
+    for (; i < xn && i < rn; ++i) {
+        MpWide t = (MpWide)r[i] + x[i] + carry;
+        r[i] = (uint64_t)t;
+        carry = (uint64_t)(t >> 64);
+    }
+    for (; carry != 0 && i < rn; ++i) {
+        r[i] += carry;
+        carry = (r[i] == 0);
+    }
+}
+
+// r[0, rn) -= x[0, xn) with xn <= rn, the result is known to be positive
+static void mag_sub_from(uint64_t *r, int rn, const uint64_t *x, int xn)
+{
+    uint64_t borrow = 0;
+    int i = 0;
+    for (; i < xn; ++i) {
+        uint64_t d = r[i] - x[i];
+        uint64_t next = (r[i] < x[i]) || (d < borrow);
+        r[i] = d - borrow;
+        borrow = next;
+    }
+    for (; borrow != 0 && i < rn; ++i) {
+        borrow = (r[i] == 0);
+        r[i] -= 1;
+    }
+}
+
+static void mag_mul_basecase(uint64_t *r, const uint64_t *a, const uint64_t *b, int n)
+{
+    memset(r, 0, 2*n * sizeof(*r));
+
+    for (int i = 0; i < n; ++i) {
+        uint64_t carry = 0;
+        for (int j = 0; j < n; ++j) {
+            MpWide t = (MpWide)a[i] * b[j] + r[i + j] + carry;
+            r[i + j] = (uint64_t)t;
+            carry = (uint64_t)(t >> 64);
+        }
+        r[i + n] = carry;
+    }
+}
+
+// Every cross product once, doubled, then the squares on the diagonal
+static void mag_sqr_basecase(uint64_t *r, const uint64_t *a, int n)
+{
+    memset(r, 0, 2*n * sizeof(*r));
+
+    for (int i = 0; i < n; ++i) {
+        uint64_t carry = 0;
+        for (int j = i + 1; j < n; ++j) {
+            MpWide t = (MpWide)a[i] * a[j] + r[i + j] + carry;
+            r[i + j] = (uint64_t)t;
+            carry = (uint64_t)(t >> 64);
+        }
+        r[i + n] = carry;
+    }
+
+    uint64_t top = 0;
+    for (int i = 0; i < 2*n; ++i) {
+        uint64_t next = r[i] >> 63;
+        r[i] = (r[i] << 1) | top;
+        top = next;
+    }
+
+    uint64_t carry = 0;
+    for (int i = 0; i < n; ++i) {
+        MpWide square = (MpWide)a[i] * a[i];
+        MpWide t = (MpWide)r[2*i] + (uint64_t)square + carry;
+        r[2*i] = (uint64_t)t;
+        t = (MpWide)r[2*i + 1] + (uint64_t)(square >> 64) + (uint64_t)(t >> 64);
+        r[2*i + 1] = (uint64_t)t;
+        carry = (uint64_t)(t >> 64);
+    }
+}
+
+// r (2n limbs) = a b. With a = a0 + a1 B^h the middle product comes from
+// (a0 + a1)(b0 + b1) - a0 b0 - a1 b1, three half-size products instead of
+// four.
+static void mag_mul(uint64_t *r, const uint64_t *a, const uint64_t *b, int n, uint64_t *scratch)
+{
+    if (n < MP_KARATSUBA_MUL_THRESHOLD) {
+        mag_mul_basecase(r, a, b, n);
+        return;
+    }
+
+    int h = n / 2;
+    int l = n - h;
+    mag_mul(r, a, b, h, scratch);
+    mag_mul(r + 2*h, a + h, b + h, l, scratch);
+
+    uint64_t *sa = scratch;
+    uint64_t *sb = sa + (l + 1);
+    uint64_t *middle = sb + (l + 1);
+    uint64_t *rest = middle + 2*(l + 1);
+
+    memcpy(sa, a + h, l * sizeof(*sa));
+    memcpy(sb, b + h, l * sizeof(*sb));
+    sa[l] = 0;
+    sb[l] = 0;
+    mag_add_into(sa, l + 1, a, h);
+    mag_add_into(sb, l + 1, b, h);
+
+    mag_mul(middle, sa, sb, l + 1, rest);
+    mag_sub_from(middle, 2*(l + 1), r, 2*h);
+    mag_sub_from(middle, 2*(l + 1), r + 2*h, 2*l);
+    mag_add_into(r + h, 2*n - h, middle, 2*(l + 1));
+}
+
+static void mag_sqr(uint64_t *r, const uint64_t *a, int n, uint64_t *scratch)
+{
+    if (n < MP_KARATSUBA_SQR_THRESHOLD) {
+        mag_sqr_basecase(r, a, n);
+        return;
+    }
+
+    int h = n / 2;
+    int l = n - h;
+    mag_sqr(r, a, h, scratch);
+    mag_sqr(r + 2*h, a + h, l, scratch);
+
+    uint64_t *sa = scratch;
+    uint64_t *middle = sa + (l + 1);
+    uint64_t *rest = middle + 2*(l + 1);
+
+    memcpy(sa, a + h, l * sizeof(*sa));
+    sa[l] = 0;
+    mag_add_into(sa, l + 1, a, h);
+
+    mag_sqr(middle, sa, l + 1, rest);
+    mag_sub_from(middle, 2*(l + 1), r, 2*h);
+    mag_sub_from(middle, 2*(l + 1), r + 2*h, 2*l);
+    mag_add_into(r + h, 2*n - h, middle, 2*(l + 1));
+}
+
+/* Fixed point numbers */
+
+int mp_limbs_for_bits(int bits)
+{
+    int limbs = 1 + (bits + 63) / 64;
+
+    if (limbs < 2) limbs = 2;
+    if (limbs > MP_MAX_LIMBS) limbs = MP_MAX_LIMBS;
+
+    return limbs;
+}
+
+void mp_zero(MpFixed *r)
+{
+    memset(r, 0, sizeof(*r));
+}
+
+// Exact, the 64-bit mantissa is placed at its bit position and whatever
+// falls below the last limb is dropped
+void mp_from_long_double(MpFixed *r, long double value)
+{
+    mp_zero(r);
+    if (value == 0.0L || !isfinite(value)) return;
+
+    int e;
+    long double m = frexpl(fabsl(value), &e);
+    uint64_t mantissa = (uint64_t)ldexpl(m, 64);
+
+    // Bit index of the lowest mantissa bit, counted from the bottom of limb 0
+    long position = (long)e - 64 + 64L*(MP_MAX_LIMBS - 1);
+    assert(position + 64 <= 64L*MP_MAX_LIMBS);
+    if (position < 0) {
+        if (position <= -64) return;
+        mantissa >>= -position;
+        position = 0;
+    }
+
+    int index = position / 64;
+    int shift = position % 64;
+    r->limb[index] = mantissa << shift;
+    if (shift > 0 && index + 1 < MP_MAX_LIMBS) r->limb[index + 1] = mantissa >> (64 - shift);
+    r->negative = value < 0.0L;
+}
+
+long double mp_to_long_double(const MpFixed *a, int n)
+{
+    for (int i = MP_MAX_LIMBS - 1; i >= MP_MAX_LIMBS - n; --i) {
+        if (a->limb[i] == 0) continue;
+
+        int exponent = 64*(i - (MP_MAX_LIMBS - 1));
+        long double value = ldexpl((long double)a->limb[i], exponent);
+        if (i > MP_MAX_LIMBS - n) value += ldexpl((long double)a->limb[i - 1], exponent - 64);
+
+        return a->negative ? -value : value;
+    }
+
+    return 0.0L;
+}
+
+double mp_to_double(const MpFixed *a, int n)
+{
+    for (int i = MP_MAX_LIMBS - 1; i >= MP_MAX_LIMBS - n; --i) {
+        if (a->limb[i] == 0) continue;
+
+        int exponent = 64*(i - (MP_MAX_LIMBS - 1));
+        double value = ldexp((double)a->limb[i], exponent);
+        if (i > MP_MAX_LIMBS - n) value += ldexp((double)a->limb[i - 1], exponent - 64);
+
+        return a->negative ? -value : value;
+    }
+
+    return 0.0;
+}
+
+bool mp_equal(const MpFixed *a, const MpFixed *b, int n)
+{
+    const uint64_t *pa = mp_top_const(a, n);
+    const uint64_t *pb = mp_top_const(b, n);
+    bool zero = mag_is_zero(pa, n);
+
+    return mag_cmp(pa, pb, n) == 0 && (zero || a->negative == b->negative);
+}
+
+// Adds magnitudes when the signs agree, subtracts the smaller from the
+// larger otherwise
+static void mp_add_signed(MpFixed *r, const MpFixed *a, const MpFixed *b, bool b_negative, int n)
+{
+    const uint64_t *pa = mp_top_const(a, n);
+    const uint64_t *pb = mp_top_const(b, n);
+    uint64_t *pr = mp_top(r, n);
+    bool a_negative = a->negative;
+
+    if (a_negative == b_negative) {
+        mag_add(pr, pa, pb, n);
+        r->negative = a_negative;
+    } else if (mag_cmp(pa, pb, n) >= 0) {
+        mag_sub(pr, pa, pb, n);
+        r->negative = a_negative;
+    } else {
+        mag_sub(pr, pb, pa, n);
+        r->negative = b_negative;
+    }
+    if (mag_is_zero(pr, n)) r->negative = false;
+}
+
+void mp_add(MpFixed *r, const MpFixed *a, const MpFixed *b, int n)
+{
+    mp_add_signed(r, a, b, b->negative, n);
+}
+
+void mp_sub(MpFixed *r, const MpFixed *a, const MpFixed *b, int n)
+{
+    mp_add_signed(r, a, b, !b->negative, n);
+}
+
+// Both factors have n - 1 limbs of fraction, the product 2(n - 1): its
+// limbs n - 1 up to 2n - 2 are the truncated result
+void mp_mul(MpFixed *r, const MpFixed *a, const MpFixed *b, int n)
+{
+    uint64_t product[2*MP_MAX_LIMBS];
+    uint64_t scratch[MP_SCRATCH_LIMBS];
+    bool negative = a->negative != b->negative;
+
+    mag_mul(product, mp_top_const(a, n), mp_top_const(b, n), n, scratch);
+    uint64_t *pr = mp_top(r, n);
+    memcpy(pr, product + n - 1, n * sizeof(*pr));
+    r->negative = negative && !mag_is_zero(pr, n);
+}
+
+void mp_sqr(MpFixed *r, const MpFixed *a, int n)
+{
+    uint64_t product[2*MP_MAX_LIMBS];
+    uint64_t scratch[MP_SCRATCH_LIMBS];
+
+    mag_sqr(product, mp_top_const(a, n), n, scratch);
+    memcpy(mp_top(r, n), product + n - 1, n * sizeof(*r->limb));
+    r->negative = false;
+}
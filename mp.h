@@ -0,0 +1,48 @@
+#ifndef MP_H
+#define MP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Multi-precision fixed point, for the camera of deep zooms and the
+// reference orbit of perturbation. A number is a sign and a magnitude of
+// MP_MAX_LIMBS 64-bit limbs, least significant first: the top limb holds the
+// integer part and every limb below it 64 more bits of fraction.
+//
+// The operations take the number of limbs `n` they work with, counted from
+// the top. n limbs carry 64*(n - 1) bits of fraction, the limbs below them
+// are ignored and left as they are. Results may alias the operands and
+// nothing allocates, the multiplication scratch lives on the stack.
+
+#define MP_MAX_LIMBS 256 // 16320 bits of fraction, about as deep as the scale of a view goes
+
+// Products of at least this many limbs split with Karatsuba. The schoolbook
+// square only takes half the limb products, so it holds out longer.
+#define MP_KARATSUBA_MUL_THRESHOLD 32
+#define MP_KARATSUBA_SQR_THRESHOLD 64
+
+typedef struct {
+    uint64_t limb[MP_MAX_LIMBS];
+    bool negative;
+} MpFixed;
+
+typedef struct {
+    MpFixed x;
+    MpFixed y;
+} MpVector2;
+
+// Limbs needed for `bits` bits of fraction, clamped to what fits
+int mp_limbs_for_bits(int bits);
+
+void mp_zero(MpFixed *r);
+void mp_from_long_double(MpFixed *r, long double value);
+long double mp_to_long_double(const MpFixed *a, int n);
+double mp_to_double(const MpFixed *a, int n);
+bool mp_equal(const MpFixed *a, const MpFixed *b, int n);
+
+void mp_add(MpFixed *r, const MpFixed *a, const MpFixed *b, int n);
+void mp_sub(MpFixed *r, const MpFixed *a, const MpFixed *b, int n);
+void mp_mul(MpFixed *r, const MpFixed *a, const MpFixed *b, int n);
+void mp_sqr(MpFixed *r, const MpFixed *a, int n);
+
+#endif // MP_H
@@ -0,0 +1,149 @@
+#include "nucleus.h"
+
+#include <math.h>
+#include <stdbool.h>
+
+// Even-odd rule along the positive real axis, the corners in order around
+// the polygon
+static bool nucleus_surrounds_origin(const long double *x, const long double *y, int count)
+{
+    bool inside = false;
+
+    for (int i = 0, j = count - 1; i < count; j = i++) {
+        if ((y[i] > 0.0L) == (y[j] > 0.0L)) continue;
+
+        // Where the edge crosses the real axis
+        long double crossing = x[j] - y[j] * (x[i] - x[j]) / (y[i] - y[j]);
+        if (crossing > 0.0L) inside = !inside;
+    }
+
+    return inside;
+}
+
+int nucleus_box_period(const ReferenceOrbit *reference, long double radius_x, long double radius_y)
+{
+    // Counterclockwise from the bottom left corner
+    const long double dcr[4] = { -radius_x, radius_x, radius_x, -radius_x };
+    const long double dci[4] = { -radius_y, -radius_y, radius_y, radius_y };
+    long double dr[4] = { 0.0L };
+    long double di[4] = { 0.0L };
+    long double x[4];
+    long double y[4];
+
+    for (int n = 0; n + 1 < reference->length; ++n) {
+        long double zr = reference->zr[n];
+        long double zi = reference->zi[n];
+
+        for (int k = 0; k < 4; ++k) {
+            // d_{n+1} = (2 Z_n + d_n) d_n + dc
+            long double tr = 2.0L*zr + dr[k];
+            long double ti = 2.0L*zi + di[k];
+            long double r = tr*dr[k] - ti*di[k] + dcr[k];
+            di[k] = tr*di[k] + ti*dr[k] + dci[k];
+            dr[k] = r;
+
+            x[k] = reference->zr[n + 1] + dr[k];
+            y[k] = reference->zi[n + 1] + di[k];
+            if (fabsl(x[k] + y[k]) > MANDEL_INFINITY) return 0;
+        }
+
+        if (nucleus_surrounds_origin(x, y, 4)) return n + 1;
+    }
+
+    return 0;
+}
+
+// a / b by Smith's method, which keeps |b|^2 from overflowing when the
+// derivative is huge
+static void nucleus_divide(long double *qr, long double *qi, long double ar, long double ai,
+        long double br, long double bi)
+{
+    if (fabsl(br) >= fabsl(bi)) {
+        long double ratio = bi / br;
+        long double denominator = br + bi*ratio;
+        *qr = (ar + ai*ratio) / denominator;
+        *qi = (ai - ar*ratio) / denominator;
+    } else {
+        long double ratio = br / bi;
+        long double denominator = br*ratio + bi;
+        *qr = (ar*ratio + ai) / denominator;
+        *qi = (ai*ratio - ar) / denominator;
+    }
+}
+
+bool nucleus_newton(MpVector2 *c, int period, int limbs, long double tolerance)
+{
+    MpVector2 z;
+    MpFixed zr2, zi2, t;
+
+    for (int step = 0; step < NUCLEUS_NEWTON_STEPS; ++step) {
+        // z_n in full precision and dz_n/dc next to it, which only needs the
+        // relative precision of a long double:
+        //
+        //   dz_{n+1} = 2 z_n dz_n + 1
+        mp_zero(&z.x);
+        mp_zero(&z.y);
+        long double x = 0.0L;
+        long double y = 0.0L;
+        long double dr = 0.0L;
+        long double di = 0.0L;
+
+        for (int n = 0; n < period; ++n) {
+            long double r = 2.0L*(x*dr - y*di) + 1.0L;
+            di = 2.0L*(x*di + y*dr);
+            dr = r;
+
+            mp_sqr(&zr2, &z.x, limbs);
+            mp_sqr(&zi2, &z.y, limbs);
+            mp_add(&t, &z.x, &z.y, limbs);
+            mp_sqr(&t, &t, limbs);
+            mp_sub(&t, &t, &zr2, limbs);
+            mp_sub(&t, &t, &zi2, limbs);
+            mp_add(&z.y, &t, &c->y, limbs);
+            mp_sub(&t, &zr2, &zi2, limbs);
+            mp_add(&z.x, &t, &c->x, limbs);
+
+            x = mp_to_long_double(&z.x, limbs);
+            y = mp_to_long_double(&z.y, limbs);
+            if (fabsl(x + y) > MANDEL_INFINITY) return false;
+        }
+        if (!isfinite(dr) || !isfinite(di) || (dr == 0.0L && di == 0.0L)) return false;
+
+        // c -= z_period / dz_period
+        long double qr, qi;
+        nucleus_divide(&qr, &qi, x, y, dr, di);
+        if (!isfinite(qr) || !isfinite(qi)) return false;
+
+        mp_from_long_double(&t, qr);
+        mp_sub(&c->x, &c->x, &t, limbs);
+        mp_from_long_double(&t, qi);
+        mp_sub(&c->y, &c->y, &t, limbs);
+
+        if (fabsl(qr) + fabsl(qi) <= tolerance) return true;
+    }
+
+    return false;
+}
+
+bool nucleus_locate(MpVector2 *nucleus, int *period, const MpVector2 *center, long double radius_x,
+        long double radius_y, int limbs, int max_period, long double tolerance)
+{
+    ReferenceOrbit reference = { 0 };
+    reference_compute(&reference, center, limbs, max_period + 1);
+    *period = nucleus_box_period(&reference, radius_x, radius_y);
+    reference_free(&reference);
+    if (*period == 0) return false;
+
+    *nucleus = *center;
+    if (!nucleus_newton(nucleus, *period, limbs, tolerance)) return false;
+
+    // Newton's method may as well settle on a nucleus of the same period
+    // outside the box
+    MpFixed offset;
+    mp_sub(&offset, &nucleus->x, &center->x, limbs);
+    if (fabsl(mp_to_long_double(&offset, limbs)) > fabsl(radius_x)) return false;
+    mp_sub(&offset, &nucleus->y, &center->y, limbs);
+    if (fabsl(mp_to_long_double(&offset, limbs)) > fabsl(radius_y)) return false;
+
+    return true;
+}
@@ -0,0 +1,38 @@
+#ifndef NUCLEUS_H
+#define NUCLEUS_H
+
+#include <stdbool.h>
+
+#include "mp.h"
+#include "perturb.h"
+
+// Nuclei of the minibrots, the points c whose orbit comes back to 0 after
+// `period` steps. A nucleus makes the best reference for perturbation: its
+// orbit never escapes, and pixels around it follow it the longest.
+//
+// The period is found with the box method: the corners of the view are
+// iterated as one polygon, and the first step at which the polygon winds
+// around 0 is the lowest period of a nucleus inside it. Newton's method on
+// z_period(c) = 0 then refines the nucleus to full precision.
+
+#define NUCLEUS_NEWTON_STEPS 64
+
+// Lowest period of a nucleus inside the box of half sizes `radius_x` and
+// `radius_y` around the start C of `reference`, whose orbit runs the search.
+// The corners go along as long double offsets from it, which keeps their
+// exponent down to the deepest view. Returns 0 if the box does not wind
+// around 0 before the orbit ends or a corner escapes.
+int nucleus_box_period(const ReferenceOrbit *reference, long double radius_x, long double radius_y);
+
+// Moves `c` onto the nucleus of `period` nearest to it, in `limbs` limbs. It
+// is done once a Newton step is below `tolerance`, false if that does not
+// happen within NUCLEUS_NEWTON_STEPS steps or the orbit escapes.
+bool nucleus_newton(MpVector2 *c, int period, int limbs, long double tolerance);
+
+// Both of the above: the nucleus of lowest period up to `max_period` in the
+// box around `center`, refined to `tolerance`. Fails when none is found or
+// Newton's method lands outside the box.
+bool nucleus_locate(MpVector2 *nucleus, int *period, const MpVector2 *center, long double radius_x,
+        long double radius_y, int limbs, int max_period, long double tolerance);
+
+#endif // NUCLEUS_H
@@ -0,0 +1,58 @@
+#include "palette.h"
+
+#include <math.h>
+
+const char *palette_name(Palette palette)
+{
+    switch (palette) {
+    case PALETTE_GRAY:  return "gray";
+    case PALETTE_FIRE:  return "fire";
+    case PALETTE_OCEAN: return "ocean";
+    default:            return "unknown";
+    }
+}
+
+static double palette_clamp(double value)
+{
+    return (value < 0.0) ? 0.0 : (value > 1.0) ? 1.0 : value;
+}
+
+// Colour of the count at `norm` = count / iterations, in [0, 1]
+static void palette_color(Palette palette, double norm, uint8_t *rgba)
+{
+    double t = sqrt(norm);
+    double r, g, b;
+
+    switch (palette) {
+    case PALETTE_FIRE:
+        r = palette_clamp(3.0*t);
+        g = palette_clamp(3.0*t - 1.0);
+        b = palette_clamp(3.0*t - 2.0);
+        break;
+    case PALETTE_OCEAN:
+        r = t*t;
+        g = t;
+        b = sqrt(t);
+        break;
+    default:
+        r = g = b = t;
+        break;
+    }
+
+    rgba[0] = r * 255;
+    rgba[1] = g * 255;
+    rgba[2] = b * 255;
+    rgba[3] = 255;
+}
+
+void palette_build(PaletteTable *table, Palette palette)
+{
+    if (table->built && table->palette == palette) return;
+
+    for (int i = 0; i <= PALETTE_SIZE; ++i) {
+        palette_color(palette, (double)i / PALETTE_SIZE, &table->rgba[4*i]);
+    }
+
+    table->palette = palette;
+    table->built = true;
+}
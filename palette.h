@@ -0,0 +1,33 @@
+#ifndef PALETTE_H
+#define PALETTE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Colour schemes for iteration counts. A scheme is turned into a table of
+// PALETTE_SIZE + 1 RGBA entries spread evenly over the smooth counts from 0
+// to the iteration limit, so colouring a pixel is a lookup and a blend of
+// the two entries around it, and a new scheme only costs building the table
+// again. The table is the same size whatever the limit. Counts that reached
+// the limit are black in every scheme.
+#define PALETTE_SIZE 4096
+
+typedef enum {
+    PALETTE_GRAY = 0, // Brightness grows with the square root of the count
+    PALETTE_FIRE,
+    PALETTE_OCEAN,
+    PALETTE_COUNT,
+} Palette;
+
+typedef struct {
+    uint8_t rgba[4 * (PALETTE_SIZE + 1)]; // Entry i is at i / PALETTE_SIZE of the limit
+    Palette palette;
+    bool built;
+} PaletteTable;
+
+const char *palette_name(Palette palette);
+
+// Fills the table for `palette`, unless it already is
+void palette_build(PaletteTable *table, Palette palette);
+
+#endif // PALETTE_H
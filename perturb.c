@@ -0,0 +1,513 @@
+#include "perturb.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#ifdef HAVE_MPFR
+#include <mpfr.h>
+#endif
+
+// FloatExp offsets move on to doubles once they grow past 2^PERTURB_DOUBLE_EXPONENT,
+// the pixel offset then only contributes far below the last bit
+#define PERTURB_DOUBLE_EXPONENT (-900)
+
+// Where an orbit is after n steps from z = 0: z_n = Z[m] + d
+typedef struct {
+    double dr;
+    double di;
+    int m;
+    int n;
+    bool escaped;
+    bool escaped_mirror;
+    bool glitched;
+} PerturbState;
+
+void reference_reserve(ReferenceOrbit *reference, int length)
+{
+    if (length <= reference->capacity) return;
+
+    reference->zr = realloc(reference->zr, length * sizeof(*reference->zr));
+    reference->zi = realloc(reference->zi, length * sizeof(*reference->zi));
+    assert(reference->zr != NULL && reference->zi != NULL);
+    reference->capacity = length;
+}
+
+static bool reference_escaped(const ReferenceOrbit *reference)
+{
+    int last = reference->length - 1;
+
+    return last > 0 && fabs(reference->zr[last] + reference->zi[last]) > MANDEL_INFINITY;
+}
+
+// Z_0 = 0 for an empty orbit, false if the orbit has escaped and ends
+// where it is
+static bool reference_resume(ReferenceOrbit *reference, MpVector2 *z, int length)
+{
+    reference_reserve(reference, (length > 1) ? length : 1);
+    if (reference->length > 0) return !reference_escaped(reference);
+
+    reference->zr[0] = 0.0;
+    reference->zi[0] = 0.0;
+    reference->length = 1;
+    mp_zero(&z->x);
+    mp_zero(&z->y);
+
+    return true;
+}
+
+void reference_free(ReferenceOrbit *reference)
+{
+    free(reference->zr);
+    free(reference->zi);
+    reference->zr = NULL;
+    reference->zi = NULL;
+    reference->length = 0;
+    reference->capacity = 0;
+}
+
+// Z_{n+1} = Z_n^2 + C with three squares: the imaginary part comes from
+// (x + y)^2 - x^2 - y^2, and squares are cheaper than products
+void reference_extend_fixed(ReferenceOrbit *reference, const MpVector2 *c, MpVector2 *z, int limbs, int length)
+{
+    if (!reference_resume(reference, z, length)) return;
+
+    MpFixed zr2, zi2, t;
+    MpFixed *zr = &z->x;
+    MpFixed *zi = &z->y;
+
+    int n = reference->length;
+    while (n < length) {
+        mp_sqr(&zr2, zr, limbs);
+        mp_sqr(&zi2, zi, limbs);
+        mp_add(&t, zr, zi, limbs);
+        mp_sqr(&t, &t, limbs);
+        mp_sub(&t, &t, &zr2, limbs);
+        mp_sub(&t, &t, &zi2, limbs);
+        mp_add(zi, &t, &c->y, limbs);
+        mp_sub(&t, &zr2, &zi2, limbs);
+        mp_add(zr, &t, &c->x, limbs);
+
+        double x = mp_to_double(zr, limbs);
+        double y = mp_to_double(zi, limbs);
+        reference->zr[n] = x;
+        reference->zi[n] = y;
+        ++n;
+
+        if (fabs(x + y) > MANDEL_INFINITY) break;
+    }
+
+    reference->length = n;
+}
+
+void reference_compute_fixed(ReferenceOrbit *reference, const MpVector2 *c, int limbs, int length)
+{
+    MpVector2 z;
+
+    reference->length = 0;
+    reference_extend_fixed(reference, c, &z, limbs, length);
+}
+
+#ifdef HAVE_MPFR
+// Exact: the limbs go in 32 bits at a time, which an unsigned long holds on
+// every platform
+static void reference_mpfr_set(mpfr_t r, const MpFixed *a, int limbs)
+{
+    mpfr_t part;
+    mpfr_init2(part, 32);
+    mpfr_set_ui(r, 0, MPFR_RNDN);
+    for (int i = MP_MAX_LIMBS - limbs; i < MP_MAX_LIMBS; ++i) {
+        long exponent = 64L*(i - (MP_MAX_LIMBS - 1));
+        mpfr_set_ui_2exp(part, (unsigned long)(a->limb[i] & 0xffffffffu), exponent, MPFR_RNDN);
+        mpfr_add(r, r, part, MPFR_RNDN);
+        mpfr_set_ui_2exp(part, (unsigned long)(a->limb[i] >> 32), exponent + 32, MPFR_RNDN);
+        mpfr_add(r, r, part, MPFR_RNDN);
+    }
+    if (a->negative) mpfr_neg(r, r, MPFR_RNDN);
+    mpfr_clear(part);
+}
+
+// Back into `limbs` limbs, truncated, 32 bits at a time: every step only
+// scales by a power of two or takes off the integer part, which is exact
+static void reference_mpfr_get(MpFixed *r, const mpfr_t a, int limbs)
+{
+    mpfr_t t;
+    mpfr_init2(t, mpfr_get_prec(a));
+    mpfr_abs(t, a, MPFR_RNDN);
+    mp_zero(r);
+
+    // The integer part of t is the next limb
+    for (int i = MP_MAX_LIMBS - 1; i >= MP_MAX_LIMBS - limbs; --i) {
+        mpfr_div_2ui(t, t, 32, MPFR_RNDN);
+        uint64_t hi = mpfr_get_ui(t, MPFR_RNDZ);
+        mpfr_sub_ui(t, t, hi, MPFR_RNDN);
+        mpfr_mul_2ui(t, t, 32, MPFR_RNDN);
+        uint64_t lo = mpfr_get_ui(t, MPFR_RNDZ);
+        mpfr_sub_ui(t, t, lo, MPFR_RNDN);
+        mpfr_mul_2ui(t, t, 64, MPFR_RNDN);
+        r->limb[i] = (hi << 32) | lo;
+    }
+    r->negative = mpfr_sgn(a) < 0;
+
+    mpfr_clear(t);
+}
+
+void reference_extend_mpfr(ReferenceOrbit *reference, const MpVector2 *c, MpVector2 *z, int limbs, int length)
+{
+    if (!reference_resume(reference, z, length)) return;
+
+    mpfr_prec_t precision = 64*limbs;
+    mpfr_t cr, ci, zr, zi, zr2, zi2, t;
+    mpfr_inits2(precision, cr, ci, zr, zi, zr2, zi2, t, (mpfr_ptr)NULL);
+    reference_mpfr_set(cr, &c->x, limbs);
+    reference_mpfr_set(ci, &c->y, limbs);
+    reference_mpfr_set(zr, &z->x, limbs);
+    reference_mpfr_set(zi, &z->y, limbs);
+
+    int n = reference->length;
+    while (n < length) {
+        mpfr_sqr(zr2, zr, MPFR_RNDN);
+        mpfr_sqr(zi2, zi, MPFR_RNDN);
+        mpfr_add(t, zr, zi, MPFR_RNDN);
+        mpfr_sqr(t, t, MPFR_RNDN);
+        mpfr_sub(t, t, zr2, MPFR_RNDN);
+        mpfr_sub(t, t, zi2, MPFR_RNDN);
+        mpfr_add(zi, t, ci, MPFR_RNDN);
+        mpfr_sub(t, zr2, zi2, MPFR_RNDN);
+        mpfr_add(zr, t, cr, MPFR_RNDN);
+
+        double x = mpfr_get_d(zr, MPFR_RNDN);
+        double y = mpfr_get_d(zi, MPFR_RNDN);
+        reference->zr[n] = x;
+        reference->zi[n] = y;
+        ++n;
+
+        if (fabs(x + y) > MANDEL_INFINITY) break;
+    }
+
+    reference->length = n;
+    reference_mpfr_get(&z->x, zr, limbs);
+    reference_mpfr_get(&z->y, zi, limbs);
+    mpfr_clears(cr, ci, zr, zi, zr2, zi2, t, (mpfr_ptr)NULL);
+}
+
+void reference_compute_mpfr(ReferenceOrbit *reference, const MpVector2 *c, int limbs, int length)
+{
+    MpVector2 z;
+
+    reference->length = 0;
+    reference_extend_mpfr(reference, c, &z, limbs, length);
+}
+#endif // HAVE_MPFR
+
+void reference_extend(ReferenceOrbit *reference, const MpVector2 *c, MpVector2 *z, int limbs, int length)
+{
+#ifdef HAVE_MPFR
+    if (limbs >= REFERENCE_MPFR_LIMBS) {
+        reference_extend_mpfr(reference, c, z, limbs, length);
+        return;
+    }
+#endif
+    reference_extend_fixed(reference, c, z, limbs, length);
+}
+
+void reference_compute(ReferenceOrbit *reference, const MpVector2 *c, int limbs, int length)
+{
+    MpVector2 z;
+
+    reference->length = 0;
+    reference_extend(reference, c, &z, limbs, length);
+}
+
+// Dropping d^2 from a single step is off by |d|/|2 Z| relative to the step,
+// so it is valid up to |d| < epsilon |2 Z|. Past |Z| = 2 the reference is
+// about to escape and z could cross the escape radius within the step, those
+// steps are never skipped.
+static BlaStep bla_single(double zr, double zi, double epsilon)
+{
+    double z = hypot(zr, zi);
+
+    return (BlaStep){
+        .ar = 2.0*zr, .ai = 2.0*zi,
+        .br = 1.0, .bi = 0.0,
+        .r = (z < 2.0) ? epsilon * 2.0*z : 0.0,
+    };
+}
+
+// x followed by y: d enters y as A_x d + B_x dc, which has to be within r_y
+static BlaStep bla_merge(BlaStep x, BlaStep y, double radius)
+{
+    BlaStep step = {
+        .ar = y.ar*x.ar - y.ai*x.ai,
+        .ai = y.ar*x.ai + y.ai*x.ar,
+        .br = y.ar*x.br - y.ai*x.bi + y.br,
+        .bi = y.ar*x.bi + y.ai*x.br + y.bi,
+    };
+
+    double a = hypot(x.ar, x.ai);
+    double r = (a > 0.0) ? (y.r - hypot(x.br, x.bi)*radius) / a : 0.0;
+    step.r = fmin(x.r, fmax(r, 0.0));
+    if (!isfinite(step.r) || !isfinite(step.ar) || !isfinite(step.ai) || !isfinite(step.br) || !isfinite(step.bi)) {
+        step.r = 0.0;
+    }
+
+    return step;
+}
+
+void bla_build(BlaTable *bla, const ReferenceOrbit *reference, double epsilon, double radius)
+{
+    // Single steps from m = 1 up to the last index
+    int count = reference->length - 2;
+    if (count < 0) count = 0;
+
+    int total = 0;
+    for (int c = count; c > 0; c /= 2) total += c;
+    if (total > bla->capacity) {
+        free(bla->steps);
+        bla->steps = malloc(total * sizeof(*bla->steps));
+        assert(bla->steps != NULL);
+        bla->capacity = total;
+    }
+
+    bla->levels = 0;
+    bla->level_count[0] = 0;
+    if (count == 0) return;
+
+    bla->level_start[0] = 0;
+    bla->level_count[0] = count;
+    for (int j = 0; j < count; ++j) {
+        bla->steps[j] = bla_single(reference->zr[1 + j], reference->zi[1 + j], epsilon);
+    }
+    bla->levels = 1;
+
+    while (bla->levels < BLA_MAX_LEVELS && bla->level_count[bla->levels - 1] >= 2) {
+        int below = bla->levels - 1;
+        const BlaStep *lower = &bla->steps[bla->level_start[below]];
+        int start = bla->level_start[below] + bla->level_count[below];
+        int level_count = bla->level_count[below] / 2;
+
+        for (int j = 0; j < level_count; ++j) {
+            bla->steps[start + j] = bla_merge(lower[2*j], lower[2*j + 1], radius);
+        }
+        bla->level_start[bla->levels] = start;
+        bla->level_count[bla->levels] = level_count;
+        ++bla->levels;
+    }
+}
+
+void bla_free(BlaTable *bla)
+{
+    free(bla->steps);
+    bla->steps = NULL;
+    bla->capacity = 0;
+    bla->levels = 0;
+    bla->level_count[0] = 0;
+}
+
+// Longest step from index m that |d| is within, NULL if there is none.
+// Merging never grows the radius past that of the first single step, so
+// shallow offsets are turned down after one comparison.
+static inline const BlaStep *bla_lookup(const BlaTable *bla, int m, double dr, double di, int *length)
+{
+    if (m < 1 || m - 1 >= bla->level_count[0]) return NULL;
+
+    int offset = m - 1;
+    double d2 = dr*dr + di*di;
+    double r = bla->steps[offset].r;
+    if (d2 >= r*r) return NULL;
+
+    int level = (offset == 0) ? bla->levels - 1 : __builtin_ctz(offset);
+    if (level > bla->levels - 1) level = bla->levels - 1;
+
+    for (; level >= 0; --level) {
+        int j = offset >> level;
+        if (j >= bla->level_count[level]) continue;
+
+        const BlaStep *step = &bla->steps[bla->level_start[level] + j];
+        if (d2 < step->r*step->r) {
+            *length = 1 << level;
+            return step;
+        }
+    }
+
+    return NULL;
+}
+
+// Where the counts of a pixel and of its conjugate go
+typedef struct {
+    int *count;
+    int *count_mirror;
+    float *fraction;
+    float *fraction_mirror;
+} PerturbOut;
+
+// Points at entry i of the outputs, or at `discard` for those that are NULL
+static inline PerturbOut perturb_out(int *out, int *out_mirror, float *out_fraction, float *out_fraction_mirror,
+        int i, PerturbOut discard)
+{
+    return (PerturbOut){
+        .count = &out[i],
+        .count_mirror = (out_mirror != NULL) ? &out_mirror[i] : discard.count_mirror,
+        .fraction = (out_fraction != NULL) ? &out_fraction[i] : discard.fraction,
+        .fraction_mirror = (out_mirror != NULL && out_fraction_mirror != NULL)
+            ? &out_fraction_mirror[i] : discard.fraction_mirror,
+    };
+}
+
+// The reference orbit goes z_0 = 0, z_1 = C, so C in double is its second value
+static inline double reference_c(const double *z, int length, double dc)
+{
+    return ((length > 1) ? z[1] : 0.0) + dc;
+}
+
+// The escape kernels start at z = c, step n here is their step n - 1, so the
+// first escape test is on z_2 and a pixel escaping on z_n gets n - 2
+static inline void perturb_test_escape(PerturbState *state, double cr, double ci, double x, double y, PerturbOut out)
+{
+    if (state->n < 2) return;
+
+    if (!state->escaped && fabs(x + y) > MANDEL_INFINITY) {
+        *out.count = state->n - 2;
+        *out.fraction = escape_fraction(cr, ci, x, y);
+        state->escaped = true;
+    }
+    if (!state->escaped_mirror && fabs(x - y) > MANDEL_INFINITY) {
+        *out.count_mirror = state->n - 2;
+        *out.fraction_mirror = escape_fraction(cr, ci, x, y);
+        state->escaped_mirror = true;
+    }
+}
+
+static void perturb_finish(const ReferenceOrbit *reference, const BlaTable *bla, PerturbState state,
+        double dcr, double dci, int iterations, PerturbOut out, uint8_t *glitched)
+{
+    const double tolerance = PERTURB_GLITCH_TOLERANCE*PERTURB_GLITCH_TOLERANCE;
+    const double *zr = reference->zr;
+    const double *zi = reference->zi;
+    int last = reference->length - 1;
+
+    double cr = reference_c(zr, reference->length, dcr);
+    double ci = reference_c(zi, reference->length, dci);
+    double dr = state.dr;
+    double di = state.di;
+    int m = state.m;
+
+    while (state.n <= iterations && !(state.escaped && state.escaped_mirror)) {
+        int length;
+        const BlaStep *step = (bla != NULL) ? bla_lookup(bla, m, dr, di, &length) : NULL;
+        if (step != NULL) {
+            // z stays next to the reference for the whole step, it cannot
+            // escape in between
+            double nr = step->ar*dr - step->ai*di + step->br*dcr - step->bi*dci;
+            double ni = step->ar*di + step->ai*dr + step->br*dci + step->bi*dcr;
+            dr = nr;
+            di = ni;
+            m += length;
+            state.n += length;
+        } else {
+            double tr = 2.0*zr[m] + dr;
+            double ti = 2.0*zi[m] + di;
+            double nr = tr*dr - ti*di + dcr;
+            double ni = tr*di + ti*dr + dci;
+            dr = nr;
+            di = ni;
+            ++m;
+            ++state.n;
+        }
+
+        double x = zr[m] + dr;
+        double y = zi[m] + di;
+        perturb_test_escape(&state, cr, ci, x, y, out);
+
+        double z_norm = x*x + y*y;
+        state.glitched |= z_norm < tolerance*(zr[m]*zr[m] + zi[m]*zi[m]);
+        if (z_norm < dr*dr + di*di || m == last) {
+            dr = x;
+            di = y;
+            m = 0;
+        }
+    }
+
+    if (!state.escaped) {
+        *out.count = iterations;
+        *out.fraction = 0.0f;
+    }
+    if (!state.escaped_mirror) {
+        *out.count_mirror = iterations;
+        *out.fraction_mirror = 0.0f;
+    }
+    if (glitched != NULL) *glitched = state.glitched;
+}
+
+void perturb_double(const ReferenceOrbit *reference, const BlaTable *bla, const double *dcr, const double *dci,
+        int count, int iterations, int *out, int *out_mirror, float *out_fraction, float *out_fraction_mirror,
+        uint8_t *glitched)
+{
+    int discard;
+    float discard_fraction, discard_fraction_mirror;
+    PerturbOut unused = { &discard, &discard, &discard_fraction, &discard_fraction_mirror };
+
+    for (int i = 0; i < count; ++i) {
+        PerturbState state = { .escaped_mirror = (out_mirror == NULL) };
+        perturb_finish(reference, bla, state, dcr[i], dci[i], iterations,
+                perturb_out(out, out_mirror, out_fraction, out_fraction_mirror, i, unused),
+                (glitched != NULL) ? &glitched[i] : NULL);
+    }
+}
+
+// Iterates in FloatExp only while the offset is too small for a double,
+// which at deep zooms is the first stretch of every orbit
+void perturb_floatexp(const ReferenceOrbit *reference, const BlaTable *bla, const FloatExp *dcr, const FloatExp *dci,
+        int count, int iterations, int *out, int *out_mirror, float *out_fraction, float *out_fraction_mirror,
+        uint8_t *glitched)
+{
+    const double tolerance = PERTURB_GLITCH_TOLERANCE*PERTURB_GLITCH_TOLERANCE;
+    const double *zr = reference->zr;
+    const double *zi = reference->zi;
+    int last = reference->length - 1;
+    int discard;
+    float discard_fraction, discard_fraction_mirror;
+    PerturbOut unused = { &discard, &discard, &discard_fraction, &discard_fraction_mirror };
+
+    for (int i = 0; i < count; ++i) {
+        PerturbOut pixel = perturb_out(out, out_mirror, out_fraction, out_fraction_mirror, i, unused);
+        PerturbState state = { .escaped_mirror = (out_mirror == NULL) };
+        double cr = reference_c(zr, reference->length, fe_to_double(dcr[i]));
+        double ci = reference_c(zi, reference->length, fe_to_double(dci[i]));
+        FloatExp dr = fe_zero();
+        FloatExp di = fe_zero();
+
+        while (state.n <= iterations && !(state.escaped && state.escaped_mirror)
+                && dr.e <= PERTURB_DOUBLE_EXPONENT && di.e <= PERTURB_DOUBLE_EXPONENT) {
+            int m = state.m;
+            FloatExp tr = fe_add(fe_from_double(2.0*zr[m]), dr);
+            FloatExp ti = fe_add(fe_from_double(2.0*zi[m]), di);
+            FloatExp nr = fe_add(fe_sub(fe_mul(tr, dr), fe_mul(ti, di)), dcr[i]);
+            FloatExp ni = fe_add(fe_add(fe_mul(tr, di), fe_mul(ti, dr)), dci[i]);
+            dr = nr;
+            di = ni;
+            ++state.m;
+            ++state.n;
+
+            FloatExp x = fe_add(fe_from_double(zr[state.m]), dr);
+            FloatExp y = fe_add(fe_from_double(zi[state.m]), di);
+            perturb_test_escape(&state, cr, ci, fe_to_double(x), fe_to_double(y), pixel);
+
+            FloatExp z_norm = fe_add(fe_mul(x, x), fe_mul(y, y));
+            FloatExp d_norm = fe_add(fe_mul(dr, dr), fe_mul(di, di));
+            double reference_norm = zr[state.m]*zr[state.m] + zi[state.m]*zi[state.m];
+            state.glitched |= fe_abs_less(z_norm, fe_from_double(tolerance*reference_norm));
+            if (fe_abs_less(z_norm, d_norm) || state.m == last) {
+                dr = x;
+                di = y;
+                state.m = 0;
+            }
+        }
+
+        state.dr = fe_to_double(dr);
+        state.di = fe_to_double(di);
+        perturb_finish(reference, bla, state, fe_to_double(dcr[i]), fe_to_double(dci[i]), iterations,
+                pixel, (glitched != NULL) ? &glitched[i] : NULL);
+    }
+}
@@ -0,0 +1,107 @@
+#ifndef PERTURB_H
+#define PERTURB_H
+
+#include "kernel.h"
+#include "kernel_fe.h"
+#include "mp.h"
+
+// Perturbation rendering. One reference orbit Z_n is computed at the camera
+// in the precision of the view state, and every pixel c = C + dc only
+// iterates its difference d_n = z_n - Z_n from it:
+//
+//   d_{n+1} = (2 Z_n + d_n) d_n + dc
+//
+// which needs no more precision than the offset of the pixel within the
+// view. Whenever z gets closer to 0 than to the reference, or the reference
+// runs out, the pixel is rebased onto the start of the reference
+// (d = z, n = 0), so a single reference serves the whole view.
+
+// Pixel offsets are iterated as FloatExp rather than doubles below this
+// spacing, where a double runs out of exponent
+#define PERTURB_EXTENDED_STEP 1e-290
+
+// Z_0 = 0, Z_1 = C, ... stored as doubles. The orbit ends at the first value
+// past the escape radius or after iterations + 1 steps. Only C needs the
+// precision of the view, the orbit values are bounded by the escape radius
+// and 16 bytes per step keep it in cache.
+typedef struct {
+    double *zr;
+    double *zi;
+    int length;
+    int capacity;
+} ReferenceOrbit;
+
+// Grows the orbit to hold `length` values, keeping the ones it has
+void reference_reserve(ReferenceOrbit *reference, int length);
+void reference_free(ReferenceOrbit *reference);
+
+// Iterates C = c in fixed point of `limbs` limbs into an orbit of at most
+// `length` values. Built with HAVE_MPFR, orbits of REFERENCE_MPFR_LIMBS limbs
+// and more go through MPFR at the same precision instead, which pulls ahead
+// of the fixed point there. Nothing is allocated past reserving the orbit.
+#define REFERENCE_MPFR_LIMBS 16
+void reference_compute(ReferenceOrbit *reference, const MpVector2 *c, int limbs, int length);
+void reference_compute_fixed(ReferenceOrbit *reference, const MpVector2 *c, int limbs, int length);
+#ifdef HAVE_MPFR
+void reference_compute_mpfr(ReferenceOrbit *reference, const MpVector2 *c, int limbs, int length);
+#endif
+
+// Same, continuing the orbit from its last value, which `z` holds in full
+// precision, and leaving `z` at the new last value. An empty orbit starts
+// from Z_0 = 0, one that has escaped stays as it is.
+void reference_extend(ReferenceOrbit *reference, const MpVector2 *c, MpVector2 *z, int limbs, int length);
+void reference_extend_fixed(ReferenceOrbit *reference, const MpVector2 *c, MpVector2 *z, int limbs, int length);
+#ifdef HAVE_MPFR
+void reference_extend_mpfr(ReferenceOrbit *reference, const MpVector2 *c, MpVector2 *z, int limbs, int length);
+#endif
+
+// Bilinear approximation. While d_n is small next to Z_n the square can be
+// dropped, and l steps from reference index m collapse into
+//
+//   d_{m+l} = A d_m + B dc
+//
+// which holds as long as |d_m| < r. Level 0 holds the single steps from
+// every index m >= 1 (A = 2 Z_m, B = 1), level k merges pairs of level k - 1
+// into steps of 2^k that start at m = 1 + j*2^k. A pixel takes the longest
+// step that starts at its index and is valid for its |d|.
+#define BLA_EPSILON 0x1p-24 // Default relative error of a skipped step
+#define BLA_MAX_LEVELS 32
+
+typedef struct {
+    double ar, ai;
+    double br, bi;
+    double r;
+} BlaStep;
+
+typedef struct {
+    BlaStep *steps;
+    int capacity;
+    int levels;
+    int level_start[BLA_MAX_LEVELS];
+    int level_count[BLA_MAX_LEVELS];
+} BlaTable;
+
+// `radius` bounds |dc| over the view, the merged radii account for it
+void bla_build(BlaTable *bla, const ReferenceOrbit *reference, double epsilon, double radius);
+void bla_free(BlaTable *bla);
+
+// Pauldelbrot's criterion: once |Z_m + d| < PERTURB_GLITCH_TOLERANCE |Z_m|
+// the sum has cancelled most of the bits of z, and with them what tells the
+// pixel apart from its neighbours. The orbit still goes on from there
+// rebased, but the pixel is flagged so it can be redone against a reference
+// closer to it.
+#define PERTURB_GLITCH_TOLERANCE 1e-3
+
+// Same contract as the escape kernels with the points given as offsets
+// dc = dcr[i] + dci[i]*i from the reference. Orbits are not checked for
+// periodicity, interior points run up to the iteration limit. `bla` may be
+// NULL, it is only used once the offsets fit in a double. `glitched` gets a
+// flag per point when it is not NULL.
+void perturb_double(const ReferenceOrbit *reference, const BlaTable *bla, const double *dcr, const double *dci,
+        int count, int iterations, int *out, int *out_mirror, float *out_fraction, float *out_fraction_mirror,
+        uint8_t *glitched);
+void perturb_floatexp(const ReferenceOrbit *reference, const BlaTable *bla, const FloatExp *dcr, const FloatExp *dci,
+        int count, int iterations, int *out, int *out_mirror, float *out_fraction, float *out_fraction_mirror,
+        uint8_t *glitched);
+
+#endif // PERTURB_H
@@ -0,0 +1,279 @@
+#include "pool.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+typedef struct {
+    PoolTaskFn fn;
+    void *ctx;
+    int remaining;
+    pthread_mutex_t lock;
+    pthread_cond_t done;
+} PoolBatch;
+
+typedef struct {
+    PoolBatch *batch;
+    int task;
+} PoolTask;
+
+typedef struct {
+    pthread_mutex_t lock;
+    PoolTask *items;
+    int head; // Thieves take from here
+    int tail; // The owner takes from here
+    int capacity;
+} PoolDeque;
+
+typedef struct {
+    ThreadPool *pool;
+    int index;
+} PoolWorker;
+
+struct ThreadPool {
+    pthread_t *threads;
+    PoolWorker *workers;
+    PoolDeque *deques;
+    int thread_count;
+
+    atomic_int pending;
+    atomic_uint next_victim;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    bool stop;
+};
+
+static void deque_push(PoolDeque *deque, PoolTask task)
+{
+    if (deque->tail == deque->capacity) {
+        if (deque->head > 0) {
+            int count = deque->tail - deque->head;
+            memmove(deque->items, deque->items + deque->head, count * sizeof(*deque->items));
+            deque->head = 0;
+            deque->tail = count;
+        } else {
+            deque->capacity = deque->capacity == 0 ? 64 : deque->capacity * 2;
+            deque->items = realloc(deque->items, deque->capacity * sizeof(*deque->items));
+            assert(deque->items != NULL);
+        }
+    }
+    deque->items[deque->tail++] = task;
+}
+
+static bool deque_pop(PoolDeque *deque, PoolTask *task, bool steal)
+{
+    bool found = false;
+
+    pthread_mutex_lock(&deque->lock);
+    if (deque->head < deque->tail) {
+        *task = steal ? deque->items[deque->head++] : deque->items[--deque->tail];
+        if (deque->head == deque->tail) {
+            deque->head = 0;
+            deque->tail = 0;
+        }
+        found = true;
+    }
+    pthread_mutex_unlock(&deque->lock);
+
+    return found;
+}
+
+// Takes a task from the deque of `self` or steals one from another worker.
+// The submitting thread passes -1 and only ever steals.
+static bool pool_take(ThreadPool *pool, int self, PoolTask *task)
+{
+    bool found = false;
+
+    if (self >= 0) {
+        found = deque_pop(&pool->deques[self], task, false);
+    }
+
+    int start = (self >= 0) ? self + 1 : (int)atomic_fetch_add(&pool->next_victim, 1);
+    for (int i = 0; i < pool->thread_count && !found; ++i) {
+        int victim = (start + i) % pool->thread_count;
+        if (victim != self) {
+            found = deque_pop(&pool->deques[victim], task, true);
+        }
+    }
+
+    if (found) {
+        atomic_fetch_sub(&pool->pending, 1);
+    }
+
+    return found;
+}
+
+static void pool_execute(PoolTask task)
+{
+    PoolBatch *batch = task.batch;
+
+    batch->fn(batch->ctx, task.task);
+
+    pthread_mutex_lock(&batch->lock);
+    if (--batch->remaining == 0) {
+        pthread_cond_broadcast(&batch->done);
+    }
+    pthread_mutex_unlock(&batch->lock);
+}
+
+static void *pool_worker(void *arg)
+{
+    PoolWorker *worker = (PoolWorker*)arg;
+    ThreadPool *pool = worker->pool;
+
+    for (;;) {
+        PoolTask task;
+        if (pool_take(pool, worker->index, &task)) {
+            pool_execute(task);
+            continue;
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        while (atomic_load(&pool->pending) == 0 && !pool->stop) {
+            pthread_cond_wait(&pool->wake, &pool->lock);
+        }
+        bool stop = pool->stop;
+        pthread_mutex_unlock(&pool->lock);
+
+        if (stop) break;
+    }
+
+    return NULL;
+}
+
+ThreadPool *pool_create(int thread_count)
+{
+    if (thread_count < 1) thread_count = 1;
+
+    ThreadPool *pool = calloc(1, sizeof(*pool));
+    assert(pool != NULL);
+    pool->threads = calloc(thread_count, sizeof(*pool->threads));
+    pool->workers = calloc(thread_count, sizeof(*pool->workers));
+    pool->deques = calloc(thread_count, sizeof(*pool->deques));
+    assert(pool->threads != NULL && pool->workers != NULL && pool->deques != NULL);
+
+    atomic_init(&pool->pending, 0);
+    atomic_init(&pool->next_victim, 0);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+
+    for (int i = 0; i < thread_count; ++i) {
+        pthread_mutex_init(&pool->deques[i].lock, NULL);
+        pool->workers[i].pool = pool;
+        pool->workers[i].index = i;
+    }
+
+    for (int i = 0; i < thread_count; ++i) {
+        if (pthread_create(&pool->threads[i], NULL, pool_worker, &pool->workers[i]) != 0) {
+            fprintf(stderr, "ERROR: Could not create worker thread %d\n", i);
+            break;
+        }
+        pool->thread_count = i + 1;
+    }
+
+    return pool;
+}
+
+void pool_destroy(ThreadPool *pool)
+{
+    if (pool == NULL) return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = true;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->thread_count; ++i) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    for (int i = 0; i < pool->thread_count; ++i) {
+        pthread_mutex_destroy(&pool->deques[i].lock);
+        free(pool->deques[i].items);
+    }
+    pthread_cond_destroy(&pool->wake);
+    pthread_mutex_destroy(&pool->lock);
+
+    free(pool->deques);
+    free(pool->workers);
+    free(pool->threads);
+    free(pool);
+}
+
+int pool_thread_count(ThreadPool *pool)
+{
+    return (pool != NULL) ? pool->thread_count : 1;
+}
+
+void pool_run(ThreadPool *pool, int task_count, PoolTaskFn fn, void *ctx)
+{
+    if (task_count <= 0) return;
+
+    if (pool == NULL || pool->thread_count == 0) {
+        for (int i = 0; i < task_count; ++i) {
+            fn(ctx, i);
+        }
+        return;
+    }
+
+    PoolBatch batch = {
+        .fn = fn,
+        .ctx = ctx,
+        .remaining = task_count,
+    };
+    pthread_mutex_init(&batch.lock, NULL);
+    pthread_cond_init(&batch.done, NULL);
+
+    // Hand every worker a contiguous run of tasks, neighbouring tiles tend to
+    // cost about the same so stealing only kicks in where it matters
+    for (int w = 0; w < pool->thread_count; ++w) {
+        int begin = (long)task_count * w / pool->thread_count;
+        int end = (long)task_count * (w + 1) / pool->thread_count;
+        if (begin == end) continue;
+
+        PoolDeque *deque = &pool->deques[w];
+        pthread_mutex_lock(&deque->lock);
+        for (int i = end - 1; i >= begin; --i) {
+            deque_push(deque, (PoolTask){ &batch, i });
+        }
+        pthread_mutex_unlock(&deque->lock);
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    atomic_fetch_add(&pool->pending, task_count);
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+
+    // Help out until every task of this batch has been picked up. Tasks of
+    // other batches may be run too, but never once this one is finished.
+    for (;;) {
+        pthread_mutex_lock(&batch.lock);
+        bool finished = (batch.remaining == 0);
+        pthread_mutex_unlock(&batch.lock);
+
+        PoolTask task;
+        if (finished || !pool_take(pool, -1, &task)) break;
+        pool_execute(task);
+    }
+
+    pthread_mutex_lock(&batch.lock);
+    while (batch.remaining > 0) {
+        pthread_cond_wait(&batch.done, &batch.lock);
+    }
+    pthread_mutex_unlock(&batch.lock);
+
+    pthread_cond_destroy(&batch.done);
+    pthread_mutex_destroy(&batch.lock);
+}
+
+int pool_default_thread_count(void)
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return (count > 0) ? (int)count : 1;
+}
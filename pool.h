@@ -0,0 +1,24 @@
+#ifndef POOL_H
+#define POOL_H
+
+// Persistent pool of worker threads that steal work from each other.
+//
+// Tasks of a batch are spread in contiguous runs over the per-worker deques.
+// A worker pops from the back of its own deque and, once it runs dry, steals
+// from the front of the others, so workers that got cheap tasks end up
+// helping the ones that got expensive tasks. Several threads may submit
+// batches at the same time, and the submitting thread helps until its batch
+// is done.
+
+typedef void (*PoolTaskFn)(void *ctx, int task);
+
+typedef struct ThreadPool ThreadPool;
+
+ThreadPool *pool_create(int thread_count);
+void pool_destroy(ThreadPool *pool);
+int pool_thread_count(ThreadPool *pool);
+void pool_run(ThreadPool *pool, int task_count, PoolTaskFn fn, void *ctx);
+
+int pool_default_thread_count(void);
+
+#endif // POOL_H
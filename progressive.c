@@ -0,0 +1,284 @@
+#include "progressive.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static bool progressive_same_view(const RenderParams *a, const RenderParams *b)
+{
+    return a->camera.x == b->camera.x && a->camera.y == b->camera.y
+        && a->scale.x == b->scale.x && a->scale.y == b->scale.y
+        && a->width == b->width && a->height == b->height
+        && a->pixel_width == b->pixel_width && a->pixel_height == b->pixel_height
+        && a->iterations == b->iterations && a->engine == b->engine
+        && a->precision == b->precision && a->bla_epsilon == b->bla_epsilon
+        && a->symmetry == b->symmetry && a->has_center == b->has_center
+        && (!a->has_center || (mp_equal(&a->center.x, &b->center.x, MP_MAX_LIMBS)
+                && mp_equal(&a->center.y, &b->center.y, MP_MAX_LIMBS)));
+}
+
+// Whether `b` is the view `a` with a higher iteration limit
+static bool progressive_raised(const RenderParams *a, const RenderParams *b)
+{
+    RenderParams raised = *a;
+    raised.iterations = b->iterations;
+
+    return b->iterations > a->iterations && progressive_same_view(&raised, b);
+}
+
+// Moves the samples of the view along with a camera that moved by whole
+// samples, and marks the ones that came into view unknown. False when the
+// offset is not whole or nothing would be kept.
+static bool progressive_shift(Progressive *progressive, const RenderParams *previous, long double offset_x,
+        long double offset_y)
+{
+    long double column_shift = roundl(offset_x);
+    long double row_shift = roundl(offset_y);
+    if (fabsl(offset_x - column_shift) > PROGRESSIVE_WHOLE || fabsl(offset_y - row_shift) > PROGRESSIVE_WHOLE) {
+        return false;
+    }
+
+    int columns = render_columns(&progressive->view);
+    int rows = render_rows(&progressive->view);
+    if (fabsl(column_shift) >= columns || fabsl(row_shift) >= rows) return false;
+
+    // Rows are copied in the order that reads each one before it is
+    // overwritten, memmove() takes care of the columns
+    int dx = (int)column_shift;
+    int dy = (int)row_shift;
+
+    // Rows are laid out around the real axis when it is in view and from
+    // the camera otherwise, the kept samples are only on the new grid when
+    // both views lay them out the same way
+    long previous_axis, axis;
+    bool previous_visible = render_axis_row(previous, &previous_axis);
+    if (render_axis_row(&progressive->view, &axis) != previous_visible
+            || (previous_visible && axis != previous_axis - 2*dy)) {
+        return false;
+    }
+
+    // Glitch flags of perturbation passes move with the samples
+    uint8_t *glitched = progressive->scratch.glitched;
+    if (progressive->scratch.glitch_capacity < columns * rows) glitched = NULL;
+
+    int first = (dx > 0) ? 0 : -dx;
+    int last = (dx > 0) ? columns - dx : columns;
+    for (int k = 0; k < rows; ++k) {
+        int row = (dy > 0) ? k : rows - 1 - k;
+        int *iters = &progressive->iters[row * columns];
+        uint8_t *known = &progressive->known[row * columns];
+
+        if (row + dy < 0 || row + dy >= rows) {
+            memset(known, 0, columns * sizeof(*known));
+            continue;
+        }
+
+        int source = (row + dy) * columns + dx;
+        memmove(&iters[first], &progressive->iters[source + first], (last - first) * sizeof(*iters));
+        memmove(&progressive->smooth[row * columns + first], &progressive->smooth[source + first],
+                (last - first) * sizeof(*progressive->smooth));
+        memmove(&known[first], &progressive->known[source + first], (last - first) * sizeof(*known));
+        if (glitched != NULL) {
+            memmove(&glitched[row * columns + first], &glitched[source + first], (last - first) * sizeof(*glitched));
+        }
+        memset(known, 0, first * sizeof(*known));
+        memset(&known[last], 0, (columns - last) * sizeof(*known));
+    }
+
+    return true;
+}
+
+static void progressive_reset_stats(Progressive *progressive)
+{
+    memset(&progressive->stats, 0, sizeof(progressive->stats));
+    progressive->stats.precision = render_select_precision(progressive->kernels, &progressive->view);
+    progressive->stats.samples = render_columns(&progressive->view) * render_rows(&progressive->view);
+}
+
+static void progressive_restart(Progressive *progressive)
+{
+    int samples = render_columns(&progressive->view) * render_rows(&progressive->view);
+    if (samples > progressive->capacity) {
+        free(progressive->iters);
+        free(progressive->smooth);
+        free(progressive->known);
+        progressive->iters = malloc(samples * sizeof(*progressive->iters));
+        progressive->smooth = malloc(samples * sizeof(*progressive->smooth));
+        progressive->known = malloc(samples * sizeof(*progressive->known));
+        assert(progressive->iters != NULL && progressive->smooth != NULL && progressive->known != NULL);
+        progressive->capacity = samples;
+    }
+    memset(progressive->known, 0, samples * sizeof(*progressive->known));
+    render_resume_clear(&progressive->resume);
+
+    progressive->stride = PROGRESSIVE_COARSEST;
+    progressive_reset_stats(progressive);
+}
+
+// Copies the pass that just completed into the frame, called with the lock
+// held
+static void progressive_publish(Progressive *progressive)
+{
+    ProgressiveFrame *frame = &progressive->frame;
+    int samples = render_columns(&progressive->view) * render_rows(&progressive->view);
+
+    if (samples > frame->capacity) {
+        free(frame->smooth);
+        frame->smooth = malloc(samples * sizeof(*frame->smooth));
+        assert(frame->smooth != NULL);
+        frame->capacity = samples;
+    }
+    memcpy(frame->smooth, progressive->smooth, samples * sizeof(*frame->smooth));
+
+    frame->params = progressive->view;
+    frame->stride = progressive->stride;
+    frame->stats = progressive->stats;
+    ++frame->id;
+}
+
+static void *progressive_thread(void *arg)
+{
+    Progressive *progressive = (Progressive*)arg;
+    // Nothing is rendered until the first request. The generation starts
+    // from the one progressive_start() set, so a request made before the
+    // thread got here is not missed.
+    unsigned generation = 0;
+
+    pthread_mutex_lock(&progressive->lock);
+    for (;;) {
+        while (!progressive->stop && generation == atomic_load(&progressive->generation)
+                && progressive->stride == 0) {
+            pthread_cond_wait(&progressive->wake, &progressive->lock);
+        }
+        if (progressive->stop) break;
+
+        if (generation != atomic_load(&progressive->generation)) {
+            generation = atomic_load(&progressive->generation);
+
+            // A complete view whose limit went up only carries on the
+            // samples at the old limit, in a single pass. A view that only
+            // lacks its last pass is moved along with the camera instead:
+            // by whole samples only the samples that came into view are
+            // computed, by less than one the view is computed again at
+            // full resolution, over the one on screen.
+            RenderParams previous = progressive->view;
+            bool raised = progressive->stride == 0 && progressive_raised(&previous, &progressive->requested);
+            bool moved = progressive->stride <= 1 && render_same_spacing(&previous, &progressive->requested);
+            long double offset_x = 0.0L;
+            long double offset_y = 0.0L;
+            if (moved) render_grid_offset(&previous, &progressive->requested, &offset_x, &offset_y);
+
+            progressive->view = progressive->requested;
+            if (raised) {
+                progressive->stride = 1;
+                progressive_reset_stats(progressive);
+            } else if (moved && progressive_shift(progressive, &previous, offset_x, offset_y)) {
+                // Kept orbits are indexed by sample and paired by row
+                render_resume_forget(&progressive->resume);
+                progressive->stride = 1;
+                progressive_reset_stats(progressive);
+            } else if (moved && fabsl(offset_x) < 1.0L && fabsl(offset_y) < 1.0L) {
+                progressive_restart(progressive);
+                progressive->stride = 1;
+            } else {
+                progressive_restart(progressive);
+            }
+        }
+        pthread_mutex_unlock(&progressive->lock);
+
+        RenderParams pass = progressive->view;
+        pass.stride = progressive->stride;
+        pass.known = progressive->known;
+        pass.smooth = progressive->smooth;
+        pass.scratch = &progressive->scratch;
+        pass.resume = &progressive->resume;
+        pass.generation = &progressive->generation;
+        pass.generation_id = generation;
+
+        RenderStats stats;
+        bool completed = render_iterations(progressive->pool, progressive->kernels, &pass,
+                progressive->iters, &stats);
+
+        pthread_mutex_lock(&progressive->lock);
+        if (completed) {
+            progressive->stats.iterated += stats.iterated;
+            progressive->stats.interior_skipped += stats.interior_skipped;
+            progressive->stats.mirrored += stats.mirrored;
+            progressive->stats.glitched += stats.glitched;
+            progressive->stats.corrected += stats.corrected;
+            progressive->stats.resumed += stats.resumed;
+            progressive->stats.orbit_hits += stats.orbit_hits;
+            progressive->stats.orbit_extended += stats.orbit_extended;
+            progressive->stats.orbit_misses += stats.orbit_misses;
+            progressive->stats.nucleus_period = stats.nucleus_period;
+            progressive_publish(progressive);
+            progressive->stride /= 2;
+        }
+    }
+    pthread_mutex_unlock(&progressive->lock);
+
+    return NULL;
+}
+
+void progressive_start(Progressive *progressive, ThreadPool *pool, const EscapeKernels *kernels)
+{
+    memset(progressive, 0, sizeof(*progressive));
+    progressive->pool = pool;
+    progressive->kernels = kernels;
+    atomic_init(&progressive->generation, 0);
+    pthread_mutex_init(&progressive->lock, NULL);
+    pthread_cond_init(&progressive->wake, NULL);
+
+    if (pthread_create(&progressive->thread, NULL, progressive_thread, progressive) != 0) {
+        fprintf(stderr, "ERROR: Could not create the progressive rendering thread\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void progressive_stop(Progressive *progressive)
+{
+    pthread_mutex_lock(&progressive->lock);
+    progressive->stop = true;
+    atomic_fetch_add(&progressive->generation, 1);
+    pthread_cond_signal(&progressive->wake);
+    pthread_mutex_unlock(&progressive->lock);
+    pthread_join(progressive->thread, NULL);
+
+    pthread_cond_destroy(&progressive->wake);
+    pthread_mutex_destroy(&progressive->lock);
+    free(progressive->iters);
+    free(progressive->smooth);
+    free(progressive->known);
+    free(progressive->frame.smooth);
+    render_scratch_free(&progressive->scratch);
+    render_resume_free(&progressive->resume);
+}
+
+void progressive_request(Progressive *progressive, const RenderParams *params)
+{
+    pthread_mutex_lock(&progressive->lock);
+    if (!progressive_same_view(&progressive->requested, params)) {
+        progressive->requested = *params;
+        atomic_fetch_add(&progressive->generation, 1);
+        pthread_cond_signal(&progressive->wake);
+    }
+    pthread_mutex_unlock(&progressive->lock);
+}
+
+const ProgressiveFrame *progressive_acquire(Progressive *progressive, unsigned seen)
+{
+    pthread_mutex_lock(&progressive->lock);
+    if (progressive->frame.id == seen) {
+        pthread_mutex_unlock(&progressive->lock);
+        return NULL;
+    }
+
+    return &progressive->frame;
+}
+
+void progressive_release(Progressive *progressive)
+{
+    pthread_mutex_unlock(&progressive->lock);
+}
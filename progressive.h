@@ -0,0 +1,78 @@
+#ifndef PROGRESSIVE_H
+#define PROGRESSIVE_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "kernel.h"
+#include "pool.h"
+#include "render.h"
+
+#define PROGRESSIVE_COARSEST 16 // Stride of the first pass, must be a power of two
+#define PROGRESSIVE_WHOLE 1e-6L  // Offsets this close to whole samples are whole
+
+// Last completed pass, handed to the UI
+typedef struct {
+    RenderParams params; // View the frame belongs to
+    float *smooth;       // Smooth counts, valid at every stride-th column and row
+    int capacity;
+    int stride;
+    RenderStats stats;   // Summed over the passes, samples counts the whole view
+    unsigned id;         // Bumped for every published frame
+} ProgressiveFrame;
+
+// Progressive refinement of the realtime view on a background thread. The
+// first pass samples every 16th column and row, each following pass halves
+// the stride until every sample is computed. The passes share one sample
+// grid, so the samples of a coarse pass are kept and never iterated again by
+// the finer ones.
+//
+// Requesting a different view bumps the generation counter, which makes the
+// pass in flight skip the tiles it has not started yet and start over from
+// the coarsest pass. Every completed pass is copied into the frame, so the
+// UI always has the last finished image to show. A complete view whose only
+// change is a higher iteration limit is not started over: the samples at the
+// old limit are carried on from where they stopped. Neither is a view whose
+// camera moved by whole samples: its samples are shifted along and only the
+// strips that came into view are computed.
+typedef struct {
+    ThreadPool *pool;
+    const EscapeKernels *kernels;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    bool stop;
+
+    RenderParams requested;
+    atomic_uint generation;
+
+    // Owned by the background thread
+    RenderParams view;
+    int *iters;
+    float *smooth;
+    uint8_t *known;
+    int capacity;
+    RenderScratch scratch;
+    RenderResume resume;
+    RenderStats stats;
+    int stride; // Stride of the next pass, 0 once the view is complete
+
+    ProgressiveFrame frame; // Guarded by `lock`
+} Progressive;
+
+void progressive_start(Progressive *progressive, ThreadPool *pool, const EscapeKernels *kernels);
+void progressive_stop(Progressive *progressive);
+
+// Asks for `params` to be rendered, does nothing if it is already the view
+// being refined
+void progressive_request(Progressive *progressive, const RenderParams *params);
+
+// Returns the frame with the lock held if it is newer than the frame `seen`,
+// NULL otherwise. A returned frame must be handed back with
+// progressive_release().
+const ProgressiveFrame *progressive_acquire(Progressive *progressive, unsigned seen);
+void progressive_release(Progressive *progressive);
+
+#endif // PROGRESSIVE_H
@@ -0,0 +1,203 @@
+#include "refcache.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define REFCACHE_MAGIC "MBORBIT"
+#define REFCACHE_VERSION 1
+#define REFCACHE_PATH_MAX 4096
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t limbs;
+    uint64_t length;
+    uint8_t negative[4]; // Centre x and y, last value x and y
+    uint8_t escaped;
+    uint8_t padding[3];
+} RefcacheHeader;
+
+// Followed by the top `limbs` limbs of the centre and of the last value,
+// x then y each, and the `length` real parts and imaginary parts
+#define REFCACHE_VALUES 4
+
+static pthread_once_t refcache_once = PTHREAD_ONCE_INIT;
+static char refcache_dir[REFCACHE_PATH_MAX - 64]; // Room for the file name
+static bool refcache_enabled = false;
+static atomic_uint refcache_sequence;
+
+// Creates every missing directory along the path
+static bool refcache_mkdirs(char *path)
+{
+    for (char *p = path + 1; ; ++p) {
+        if (*p != '/' && *p != '\0') continue;
+
+        char saved = *p;
+        *p = '\0';
+        bool made = mkdir(path, 0755) == 0 || errno == EEXIST;
+        *p = saved;
+        if (!made) return false;
+        if (saved == '\0') return true;
+    }
+}
+
+static void refcache_init(void)
+{
+    const char *dir = getenv("MANDELBROT_ORBIT_CACHE");
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+
+    int written;
+    if (dir != NULL) {
+        if (*dir == '\0') return;
+        written = snprintf(refcache_dir, sizeof(refcache_dir), "%s", dir);
+    } else if (xdg != NULL && *xdg != '\0') {
+        written = snprintf(refcache_dir, sizeof(refcache_dir), "%s/mandelbrot", xdg);
+    } else if (home != NULL && *home != '\0') {
+        written = snprintf(refcache_dir, sizeof(refcache_dir), "%s/.cache/mandelbrot", home);
+    } else {
+        return;
+    }
+
+    if (written <= 0 || written >= (int)sizeof(refcache_dir)) {
+        fprintf(stderr, "WARNING: Reference orbit cache path is too long, the cache is off\n");
+        return;
+    }
+    if (!refcache_mkdirs(refcache_dir)) {
+        fprintf(stderr, "WARNING: Could not create the reference orbit cache %s, the cache is off\n", refcache_dir);
+        return;
+    }
+
+    refcache_enabled = true;
+}
+
+// FNV-1a over the limbs in use and the signs, the centre in the file tells
+// collisions apart
+static void refcache_path(char *path, const MpVector2 *c, int limbs)
+{
+    uint64_t hash = 0xcbf29ce484222325u;
+    uint64_t words[2] = { (uint64_t)limbs, (uint64_t)c->x.negative | (uint64_t)c->y.negative << 1 };
+
+    for (int i = 0; i < 2; ++i) {
+        hash = (hash ^ words[i]) * 0x100000001b3u;
+    }
+    for (int i = MP_MAX_LIMBS - limbs; i < MP_MAX_LIMBS; ++i) {
+        hash = (hash ^ c->x.limb[i]) * 0x100000001b3u;
+        hash = (hash ^ c->y.limb[i]) * 0x100000001b3u;
+    }
+
+    snprintf(path, REFCACHE_PATH_MAX, "%s/%016llx.orbit", refcache_dir, (unsigned long long)hash);
+}
+
+RefcacheResult refcache_load(ReferenceOrbit *reference, MpVector2 *z, const MpVector2 *c, int limbs, int length)
+{
+    pthread_once(&refcache_once, refcache_init);
+    if (!refcache_enabled) return REFCACHE_OFF;
+
+    char path[REFCACHE_PATH_MAX];
+    refcache_path(path, c, limbs);
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return REFCACHE_MISS;
+
+    struct stat st;
+    void *map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(RefcacheHeader)) {
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (map == MAP_FAILED) return REFCACHE_MISS;
+
+    const RefcacheHeader *header = map;
+    const uint64_t *values = (const uint64_t*)(header + 1);
+    size_t value_size = (size_t)REFCACHE_VALUES * limbs * sizeof(*values);
+    bool valid = memcmp(header->magic, REFCACHE_MAGIC, sizeof(header->magic)) == 0
+        && header->version == REFCACHE_VERSION && header->limbs == (uint32_t)limbs && header->length > 0
+        && (uint64_t)st.st_size == sizeof(*header) + value_size + 2*header->length*sizeof(double)
+        && header->negative[0] == c->x.negative && header->negative[1] == c->y.negative
+        && memcmp(values, &c->x.limb[MP_MAX_LIMBS - limbs], limbs * sizeof(*values)) == 0
+        && memcmp(values + limbs, &c->y.limb[MP_MAX_LIMBS - limbs], limbs * sizeof(*values)) == 0;
+
+    RefcacheResult result = REFCACHE_MISS;
+    if (valid) {
+        const double *zr = (const double*)(values + REFCACHE_VALUES*limbs);
+        const double *zi = zr + header->length;
+        int count = (header->length < (uint64_t)length) ? (int)header->length : length;
+
+        reference_reserve(reference, length);
+        memcpy(reference->zr, zr, count * sizeof(*zr));
+        memcpy(reference->zi, zi, count * sizeof(*zi));
+        reference->length = count;
+
+        result = (header->escaped || count == length) ? REFCACHE_HIT : REFCACHE_PARTIAL;
+        if (result == REFCACHE_PARTIAL) {
+            mp_zero(&z->x);
+            mp_zero(&z->y);
+            memcpy(&z->x.limb[MP_MAX_LIMBS - limbs], values + 2*limbs, limbs * sizeof(*values));
+            memcpy(&z->y.limb[MP_MAX_LIMBS - limbs], values + 3*limbs, limbs * sizeof(*values));
+            z->x.negative = header->negative[2];
+            z->y.negative = header->negative[3];
+        }
+    }
+    munmap(map, st.st_size);
+
+    return result;
+}
+
+// Written next to the file and renamed over it, so readers never see half
+// an orbit
+void refcache_store(const ReferenceOrbit *reference, const MpVector2 *z, const MpVector2 *c, int limbs)
+{
+    pthread_once(&refcache_once, refcache_init);
+    if (!refcache_enabled || reference->length <= 0) return;
+
+    char path[REFCACHE_PATH_MAX];
+    char temporary[REFCACHE_PATH_MAX + 64];
+    refcache_path(path, c, limbs);
+    snprintf(temporary, sizeof(temporary), "%s.%ld.%u", path, (long)getpid(),
+            atomic_fetch_add(&refcache_sequence, 1));
+
+    int last = reference->length - 1;
+    RefcacheHeader header = {
+        .magic = REFCACHE_MAGIC,
+        .version = REFCACHE_VERSION,
+        .limbs = limbs,
+        .length = reference->length,
+        .negative = { c->x.negative, c->y.negative, z->x.negative, z->y.negative },
+        .escaped = last > 0 && fabs(reference->zr[last] + reference->zi[last]) > MANDEL_INFINITY,
+    };
+
+    FILE *file = fopen(temporary, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "WARNING: Could not write the reference orbit cache %s\n", temporary);
+        return;
+    }
+
+    const uint64_t *values[REFCACHE_VALUES] = {
+        &c->x.limb[MP_MAX_LIMBS - limbs], &c->y.limb[MP_MAX_LIMBS - limbs],
+        &z->x.limb[MP_MAX_LIMBS - limbs], &z->y.limb[MP_MAX_LIMBS - limbs],
+    };
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+    for (int i = 0; i < REFCACHE_VALUES; ++i) {
+        written = written && fwrite(values[i], sizeof(*values[i]), limbs, file) == (size_t)limbs;
+    }
+    written = written && fwrite(reference->zr, sizeof(*reference->zr), reference->length, file) == (size_t)reference->length;
+    written = written && fwrite(reference->zi, sizeof(*reference->zi), reference->length, file) == (size_t)reference->length;
+    written = (fclose(file) == 0) && written;
+
+    if (!written || rename(temporary, path) != 0) {
+        fprintf(stderr, "WARNING: Could not write the reference orbit cache %s\n", path);
+        remove(temporary);
+    }
+}
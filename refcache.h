@@ -0,0 +1,34 @@
+#ifndef REFCACHE_H
+#define REFCACHE_H
+
+#include "mp.h"
+#include "perturb.h"
+
+// Reference orbits kept on disk between runs, one file per centre and
+// number of limbs. The directory is $MANDELBROT_ORBIT_CACHE, or
+// $XDG_CACHE_HOME/mandelbrot, or ~/.cache/mandelbrot, and setting
+// MANDELBROT_ORBIT_CACHE to an empty string turns the cache off.
+//
+// A file is a header, the centre and the last value of the orbit in full
+// precision, and then the orbit as two arrays of doubles laid out as in
+// ReferenceOrbit, so loading is a copy out of the mapped file. The last
+// value lets a longer orbit carry on where the stored one stopped. Files
+// are in the byte order of the machine that wrote them.
+
+typedef enum {
+    REFCACHE_OFF = 0, // The cache is turned off or its directory unusable
+    REFCACHE_MISS,    // No orbit stored for the centre and limbs
+    REFCACHE_PARTIAL, // The stored orbit is shorter and has not escaped
+    REFCACHE_HIT,     // The stored orbit covers the length asked for
+} RefcacheResult;
+
+// Loads at most `length` values of the orbit of `c` in `limbs` limbs. On
+// REFCACHE_PARTIAL `z` receives the last value of the shorter orbit, which
+// reference_extend() can go on from.
+RefcacheResult refcache_load(ReferenceOrbit *reference, MpVector2 *z, const MpVector2 *c, int limbs, int length);
+
+// Stores the orbit of `c` whose last value is `z`, in place of the one
+// stored before. Failing to write only prints a warning.
+void refcache_store(const ReferenceOrbit *reference, const MpVector2 *z, const MpVector2 *c, int limbs);
+
+#endif // REFCACHE_H
@@ -0,0 +1,1408 @@
+#include "render.h"
+
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    const RenderParams *params;
+    const EscapeKernels *kernels;
+    int *iters;
+    float *smooth; // May be NULL
+    uint8_t *known;
+    int columns;
+    int rows;
+    int stride;
+    Precision precision;
+    const ReferenceOrbit *reference; // For PRECISION_PERTURBATION
+    const BlaTable *bla;             // May be NULL
+    bool extended;                   // Perturbation offsets are FloatExp
+
+    // Glitched samples of a perturbation pass, NULL otherwise. The flags
+    // cover the whole grid, the list only what this pass computed.
+    uint8_t *glitched;
+    int *glitch_samples;
+    atomic_int glitch_count;
+
+    // Orbits at the limit are added to `resume` when `capture` is set
+    RenderResume *resume;
+    bool capture;
+
+    // Sample coordinates
+    RenderCoordinate *column_real;
+    RenderCoordinate *row_imag;
+
+    // Rows of this pass that are iterated. The others are either not part
+    // of the pass or filled with the conjugate counts of the row that has
+    // them in `mirror_row`.
+    int *computed_rows;
+    int computed_count;
+    int *mirror_row;
+
+    int tiles_x;
+    int tiles_y;
+
+    atomic_int tiles_done;
+    atomic_bool abandoned;
+    atomic_long iterated;
+    atomic_long interior_skipped;
+    atomic_long mirrored;
+    atomic_long resumed;
+} RenderJob;
+
+// Per tile scratch space. Samples are queued and then run through the escape
+// kernel in one batch, so the SIMD lanes always have pixels to refill from.
+// Tile columns count in steps of `stride`, tile rows are indices into
+// `computed_rows`.
+typedef struct {
+    RenderJob *job;
+    int column_start;
+    int row_start;
+
+    // Coordinates in the precision of the job
+    union {
+        float f[TILE_SIZE*TILE_SIZE];
+        double d[TILE_SIZE*TILE_SIZE];
+        long double ld[TILE_SIZE*TILE_SIZE];
+        DoubleDouble dd[TILE_SIZE*TILE_SIZE];
+        Fixed128 fx[TILE_SIZE*TILE_SIZE];
+        FloatExp fe[TILE_SIZE*TILE_SIZE];
+    } cr, ci;
+    int index[TILE_SIZE*TILE_SIZE];
+    int mirror_index[TILE_SIZE*TILE_SIZE];
+    int results[TILE_SIZE*TILE_SIZE];
+    int mirror_results[TILE_SIZE*TILE_SIZE];
+    float fractions[TILE_SIZE*TILE_SIZE];
+    float mirror_fractions[TILE_SIZE*TILE_SIZE];
+    uint8_t glitched[TILE_SIZE*TILE_SIZE];
+    int count;
+    int mirror_count;
+
+    bool done[TILE_SIZE*TILE_SIZE];
+
+    // Last z of the queued samples, and the orbits of the tile that are
+    // kept at the limit
+    union {
+        float f[TILE_SIZE*TILE_SIZE];
+        double d[TILE_SIZE*TILE_SIZE];
+    } zr, zi;
+    int kept_index[TILE_SIZE*TILE_SIZE];
+    double kept_zr[TILE_SIZE*TILE_SIZE];
+    double kept_zi[TILE_SIZE*TILE_SIZE];
+    int kept_count;
+
+    long iterated;
+    long interior_skipped;
+    long mirrored;
+} TileState;
+
+real map(real value, real inputStart, real inputEnd, real outputStart, real outputEnd)
+{
+    real result = (value - inputStart)/(inputEnd - inputStart)*(outputEnd - outputStart) + outputStart;
+
+    return result;
+}
+
+// A real has at most 113 bits, a long double 64 of them and the next one
+// the rest
+void render_mp_from_real(MpFixed *r, real value)
+{
+    long double hi = (long double)value;
+    long double lo = (long double)(value - (real)hi);
+    MpFixed t;
+
+    mp_from_long_double(r, hi);
+    mp_from_long_double(&t, lo);
+    mp_add(r, r, &t, MP_MAX_LIMBS);
+}
+
+// The top two limbs that are set hold more bits than a real, then the
+// result is scaled a limb at a time
+real render_real_from_mp(const MpFixed *a)
+{
+    for (int i = MP_MAX_LIMBS - 1; i >= 0; --i) {
+        if (a->limb[i] == 0) continue;
+
+        real value = (real)a->limb[i];
+        if (i > 0) value += (real)a->limb[i - 1] * (real)0x1p-64;
+        for (int k = i; k < MP_MAX_LIMBS - 1; ++k) value *= (real)0x1p-64;
+
+        return a->negative ? -value : value;
+    }
+
+    return 0;
+}
+
+int render_columns(const RenderParams *params)
+{
+    return (params->width + params->pixel_width - 1) / params->pixel_width;
+}
+
+bool render_same_spacing(const RenderParams *a, const RenderParams *b)
+{
+    return a->scale.x == b->scale.x && a->scale.y == b->scale.y
+        && a->width == b->width && a->height == b->height
+        && a->pixel_width == b->pixel_width && a->pixel_height == b->pixel_height
+        && a->iterations == b->iterations && a->engine == b->engine
+        && a->precision == b->precision && a->bla_epsilon == b->bla_epsilon
+        && a->symmetry == b->symmetry && a->has_center == b->has_center;
+}
+
+bool render_axis_row(const RenderParams *params, long *axis_row2)
+{
+    double axis = 2.0 * ((double)params->scale.y - params->camera.y) * params->height / (2.0 * params->scale.y)
+        / params->pixel_height;
+    *axis_row2 = lround(axis);
+
+    return axis > -1.0 && axis < 2.0*render_rows(params) - 1.0;
+}
+
+void render_grid_offset(const RenderParams *from, const RenderParams *to, long double *columns, long double *rows)
+{
+    long double dx = (long double)(to->camera.x - from->camera.x);
+    long double dy = (long double)(to->camera.y - from->camera.y);
+
+    if (from->has_center && to->has_center) {
+        MpFixed offset;
+        mp_sub(&offset, &to->center.x, &from->center.x, MP_MAX_LIMBS);
+        dx = mp_to_long_double(&offset, MP_MAX_LIMBS);
+        mp_sub(&offset, &to->center.y, &from->center.y, MP_MAX_LIMBS);
+        dy = mp_to_long_double(&offset, MP_MAX_LIMBS);
+    }
+
+    *columns = dx / (long double)(2 * from->scale.x * from->pixel_width / from->width);
+    *rows = dy / (long double)(2 * from->scale.y * from->pixel_height / from->height);
+}
+
+int render_rows(const RenderParams *params)
+{
+    return (params->height + params->pixel_height - 1) / params->pixel_height;
+}
+
+const char *render_engine_name(RenderEngine engine)
+{
+    switch (engine) {
+    case ENGINE_PIXEL:     return "Per pixel";
+    case ENGINE_SUBDIVIDE: return "Subdivision";
+    default:               return "Unknown";
+    }
+}
+
+const char *render_precision_name(Precision precision)
+{
+    switch (precision) {
+    case PRECISION_AUTO:          return "auto";
+    case PRECISION_FLOAT:         return "float";
+    case PRECISION_DOUBLE:        return "double";
+    case PRECISION_LONG_DOUBLE:   return "long double";
+    case PRECISION_DOUBLE_DOUBLE: return "double-double";
+    case PRECISION_FIXED:         return "fixed-point";
+    case PRECISION_PERTURBATION:  return "perturbation";
+    default:                      return "unknown";
+    }
+}
+
+// The margin grows with the iteration count past PRECISION_ITERATIONS, the
+// rounding error of every step adds up
+bool render_precision_resolves(const RenderParams *params, long double epsilon, double slack)
+{
+    long double step_x = 2.0L * params->scale.x * params->pixel_width / params->width;
+    long double step_y = 2.0L * params->scale.y * params->pixel_height / params->height;
+    long double step = fminl(fabsl(step_x), fabsl(step_y));
+    long double magnitude = fmaxl(fabsl((long double)params->camera.x) + fabsl((long double)params->scale.x),
+            fabsl((long double)params->camera.y) + fabsl((long double)params->scale.y));
+    double margin = PRECISION_MARGIN * slack;
+    if (params->iterations > PRECISION_ITERATIONS) margin *= (double)params->iterations / PRECISION_ITERATIONS;
+
+    return step > magnitude * epsilon * margin;
+}
+
+static Precision render_precision_for(const EscapeKernels *kernels, const RenderParams *params, double slack)
+{
+    if (render_precision_resolves(params, FLT_EPSILON, slack)) return PRECISION_FLOAT;
+    if (render_precision_resolves(params, DBL_EPSILON, slack)) return PRECISION_DOUBLE;
+    bool vector_double_double = (kernels->escape_double_double != escape_scalar_double_double);
+    if (render_precision_resolves(params, LDBL_EPSILON, slack) && !vector_double_double) return PRECISION_LONG_DOUBLE;
+    if (render_precision_resolves(params, (long double)DBL_EPSILON * DBL_EPSILON, slack)) return PRECISION_DOUBLE_DOUBLE;
+    return PRECISION_PERTURBATION;
+}
+
+// Resolves PRECISION_AUTO to the cheapest type whose spacing around the
+// largest coordinate in view is PRECISION_MARGIN times finer than the
+// spacing of the samples. Long double is skipped when double-double is
+// vectorized, which is faster than the scalar long double kernel. Views too
+// deep for double-double are rendered with perturbation.
+Precision render_select_precision(const EscapeKernels *kernels, const RenderParams *params)
+{
+    if (params->precision != PRECISION_AUTO) return params->precision;
+
+    return render_precision_for(kernels, params, 1.0);
+}
+
+Precision render_select_precision_from(const EscapeKernels *kernels, const RenderParams *params, Precision previous)
+{
+    if (params->precision != PRECISION_AUTO) return params->precision;
+
+    Precision needed = render_precision_for(kernels, params, 1.0);
+    if (previous == PRECISION_AUTO || needed >= previous) return needed;
+
+    Precision relaxed = render_precision_for(kernels, params, PRECISION_HYSTERESIS);
+    return (relaxed < previous) ? relaxed : previous;
+}
+
+// Clamped so the integer bits stay clear of overflow, only views zoomed out
+// far past the set reach the limit
+static Fixed128 render_fixed(real value)
+{
+    if (value > (real)FIXED_COORDINATE_LIMIT) value = FIXED_COORDINATE_LIMIT;
+    if (value < -(real)FIXED_COORDINATE_LIMIT) value = -FIXED_COORDINATE_LIMIT;
+
+    return (Fixed128)(value * (real)FIXED_ONE);
+}
+
+static RenderCoordinate render_coordinate(real value, real delta)
+{
+    double hi = (double)value;
+
+    return (RenderCoordinate){
+        .f = (float)value,
+        .d = hi,
+        .ld = (long double)value,
+        .dd = { hi, (double)(value - hi) },
+        .fx = render_fixed(value),
+        .delta = fe_from_long_double((long double)delta),
+    };
+}
+
+// Computes the sample coordinates and pairs up rows that are mirror images
+// of each other. When the real axis is in view the rows are laid out
+// symmetrically around it (moving the grid by at most a quarter of a sample)
+// so that the imaginary parts of paired rows are exact negatives. The grid
+// does not depend on the stride, coarse passes sample a subset of it.
+// Offsets from the camera are worked out from the position on screen, which
+// keeps them exact when the view is narrower than the spacing of `real`.
+static void render_setup_grid(RenderJob *job)
+{
+    const RenderParams *params = job->params;
+    Vector2Real camera = params->camera;
+    Vector2Real scale = params->scale;
+
+    for (int column = 0; column < job->columns; ++column) {
+        int x = column * params->pixel_width;
+        real delta = (real)(2*x - params->width) / params->width * scale.x;
+        job->column_real[column] = render_coordinate(map(x, 0, params->width, camera.x - scale.x, camera.x + scale.x), delta);
+    }
+
+    long axis_row2;
+    bool axis_visible = render_axis_row(params, &axis_row2);
+    bool symmetry = params->symmetry && axis_visible;
+
+    for (int row = 0; row < job->rows; ++row) {
+        if (axis_visible) {
+            real half_step = (real)scale.y * params->pixel_height / params->height;
+            real value = (real)(2*row - axis_row2) * half_step;
+            job->row_imag[row] = render_coordinate(value, value - camera.y);
+        } else {
+            int y = row * params->pixel_height;
+            real delta = (real)(2*y - params->height) / params->height * scale.y;
+            job->row_imag[row] = render_coordinate(map(y, 0, params->height, camera.y - scale.y, camera.y + scale.y), delta);
+        }
+
+        long mirror = axis_row2 - row;
+        job->mirror_row[row] = (symmetry && 2*row < axis_row2 && mirror < job->rows) ? mirror : -1;
+    }
+
+    int row_begin = params->row_begin;
+    int row_end = (params->row_end > 0 && params->row_end < job->rows) ? params->row_end : job->rows;
+
+    job->computed_count = 0;
+    for (int row = row_begin - row_begin % job->stride; row < row_end; row += job->stride) {
+        if (row < row_begin) continue;
+
+        // Rows filled by a row of the same pass are not iterated themselves
+        long primary = axis_row2 - row;
+        bool mirrored = symmetry && 2*row > axis_row2 && primary >= 0 && primary % job->stride == 0;
+
+        if (!mirrored) {
+            job->computed_rows[job->computed_count++] = row;
+        }
+    }
+}
+
+static inline int tile_index(TileState *tile, int column, int row)
+{
+    RenderJob *job = tile->job;
+
+    return column*job->stride + job->computed_rows[row]*job->columns;
+}
+
+// Index of the sample that receives the conjugate count, -1 if there is none
+static inline int tile_mirror_index(TileState *tile, int column, int row)
+{
+    RenderJob *job = tile->job;
+    int mirror = job->mirror_row[job->computed_rows[row]];
+
+    return (mirror >= 0) ? column*job->stride + mirror*job->columns : -1;
+}
+
+// Count plus fraction, in float. Escaped samples stay within [0, limit), so
+// only the ones at the limit read as interior.
+static inline float smooth_count(int value, float fraction, int limit)
+{
+    if (value >= limit) return value;
+
+    float smooth = value + fraction;
+    return (smooth < limit) ? fmaxf(smooth, 0.0f) : nextafterf(limit, 0.0f);
+}
+
+static inline void tile_store(TileState *tile, int index, int value, float fraction)
+{
+    tile->job->iters[index] = value;
+    if (tile->job->smooth != NULL) {
+        tile->job->smooth[index] = smooth_count(value, fraction, tile->job->params->iterations);
+    }
+    if (tile->job->known != NULL) tile->job->known[index] = 1;
+    if (tile->job->glitched != NULL) tile->job->glitched[index] = 0;
+}
+
+static inline void tile_keep(TileState *tile, int index, double zr, double zi)
+{
+    tile->kept_index[tile->kept_count] = index;
+    tile->kept_zr[tile->kept_count] = zr;
+    tile->kept_zi[tile->kept_count] = zi;
+    ++tile->kept_count;
+}
+
+static void tile_queue(TileState *tile, int column, int row)
+{
+    RenderJob *job = tile->job;
+    int local = (column - tile->column_start) + (row - tile->row_start)*TILE_SIZE;
+
+    if (tile->done[local]) return;
+    tile->done[local] = true;
+
+    int index = tile_index(tile, column, row);
+    int mirror = tile_mirror_index(tile, column, row);
+    if (job->known != NULL && job->known[index] && (mirror < 0 || job->known[mirror])) return;
+
+    const RenderCoordinate *c_real = &job->column_real[column*job->stride];
+    const RenderCoordinate *c_imag = &job->row_imag[job->computed_rows[row]];
+
+    // Only pixels outside the main cardioid and bulb go through the kernel
+    if (inside_main_bulbs(c_real->d, c_imag->d)) {
+        tile_store(tile, index, job->params->iterations, 0.0f);
+        if (job->capture) tile_keep(tile, index, NAN, NAN);
+        ++tile->interior_skipped;
+        if (mirror >= 0) {
+            tile_store(tile, mirror, job->params->iterations, 0.0f);
+            ++tile->mirrored;
+        }
+    } else {
+        switch (job->precision) {
+        case PRECISION_FLOAT:
+            tile->cr.f[tile->count] = c_real->f;
+            tile->ci.f[tile->count] = c_imag->f;
+            break;
+        case PRECISION_DOUBLE:
+            tile->cr.d[tile->count] = c_real->d;
+            tile->ci.d[tile->count] = c_imag->d;
+            break;
+        case PRECISION_LONG_DOUBLE:
+            tile->cr.ld[tile->count] = c_real->ld;
+            tile->ci.ld[tile->count] = c_imag->ld;
+            break;
+        case PRECISION_FIXED:
+            tile->cr.fx[tile->count] = c_real->fx;
+            tile->ci.fx[tile->count] = c_imag->fx;
+            break;
+        case PRECISION_PERTURBATION:
+            if (job->extended) {
+                tile->cr.fe[tile->count] = c_real->delta;
+                tile->ci.fe[tile->count] = c_imag->delta;
+            } else {
+                tile->cr.d[tile->count] = fe_to_double(c_real->delta);
+                tile->ci.d[tile->count] = fe_to_double(c_imag->delta);
+            }
+            break;
+        default:
+            tile->cr.dd[tile->count] = c_real->dd;
+            tile->ci.dd[tile->count] = c_imag->dd;
+            break;
+        }
+        tile->index[tile->count] = index;
+        tile->mirror_index[tile->count] = mirror;
+        tile->mirror_count += (mirror >= 0);
+        ++tile->count;
+    }
+}
+
+static void tile_flush(TileState *tile)
+{
+    RenderJob *job = tile->job;
+
+    if (tile->count == 0) return;
+
+    int *mirror_results = (tile->mirror_count > 0) ? tile->mirror_results : NULL;
+    // Fractions are only worked out when smooth counts are asked for
+    float *fractions = (job->smooth != NULL) ? tile->fractions : NULL;
+    float *mirror_fractions = (job->smooth != NULL) ? tile->mirror_fractions : NULL;
+    int iterations = job->params->iterations;
+    switch (job->precision) {
+    case PRECISION_FLOAT:
+        job->kernels->escape_float(tile->cr.f, tile->ci.f, tile->count, iterations,
+                tile->results, mirror_results, job->capture ? tile->zr.f : NULL, job->capture ? tile->zi.f : NULL,
+                fractions, mirror_fractions);
+        break;
+    case PRECISION_DOUBLE:
+        job->kernels->escape_double(tile->cr.d, tile->ci.d, tile->count, iterations,
+                tile->results, mirror_results, job->capture ? tile->zr.d : NULL, job->capture ? tile->zi.d : NULL,
+                fractions, mirror_fractions);
+        break;
+    case PRECISION_LONG_DOUBLE:
+        job->kernels->escape_long_double(tile->cr.ld, tile->ci.ld, tile->count, iterations,
+                tile->results, mirror_results, NULL, NULL, fractions, mirror_fractions);
+        break;
+    case PRECISION_FIXED:
+        escape_scalar_fixed(tile->cr.fx, tile->ci.fx, tile->count, iterations,
+                tile->results, mirror_results, fractions, mirror_fractions);
+        break;
+    case PRECISION_PERTURBATION:
+        if (job->extended) {
+            perturb_floatexp(job->reference, job->bla, tile->cr.fe, tile->ci.fe, tile->count, iterations,
+                    tile->results, mirror_results, fractions, mirror_fractions, tile->glitched);
+        } else {
+            perturb_double(job->reference, job->bla, tile->cr.d, tile->ci.d, tile->count, iterations,
+                    tile->results, mirror_results, fractions, mirror_fractions, tile->glitched);
+        }
+        break;
+    default:
+        job->kernels->escape_double_double(tile->cr.dd, tile->ci.dd, tile->count, iterations,
+                tile->results, mirror_results, fractions, mirror_fractions);
+        break;
+    }
+
+    int glitch_count = 0;
+    for (int k = 0; k < tile->count; ++k) {
+        tile_store(tile, tile->index[k], tile->results[k], (fractions != NULL) ? fractions[k] : 0.0f);
+        if (tile->mirror_index[k] >= 0) {
+            tile_store(tile, tile->mirror_index[k], tile->mirror_results[k],
+                    (mirror_fractions != NULL) ? mirror_fractions[k] : 0.0f);
+        }
+        if (job->precision == PRECISION_PERTURBATION && tile->glitched[k]) {
+            job->glitched[tile->index[k]] = 1;
+            tile->index[glitch_count++] = tile->index[k];
+        }
+
+        bool limit = tile->results[k] == iterations
+            || (tile->mirror_index[k] >= 0 && tile->mirror_results[k] == iterations);
+        if (job->capture && limit) {
+            if (job->precision == PRECISION_FLOAT) {
+                tile_keep(tile, tile->index[k], tile->zr.f[k], tile->zi.f[k]);
+            } else {
+                tile_keep(tile, tile->index[k], tile->zr.d[k], tile->zi.d[k]);
+            }
+        }
+    }
+
+    // The flagged samples go on the list of the job in one go
+    if (glitch_count > 0) {
+        int start = atomic_fetch_add(&job->glitch_count, glitch_count);
+        memcpy(&job->glitch_samples[start], tile->index, glitch_count * sizeof(*tile->index));
+    }
+
+    tile->iterated += tile->count;
+    tile->mirrored += tile->mirror_count;
+    tile->count = 0;
+    tile->mirror_count = 0;
+}
+
+typedef struct {
+    int x0, y0; // Inclusive corners
+    int x1, y1;
+} TileRect;
+
+// Checks that every border sample of the rectangle has the same count, and
+// so do the mirrored samples of paired rows, which are filled along with
+// the computed ones. A glitched border is never filled, its count may be
+// off until it is corrected.
+static bool tile_rect_uniform(TileState *tile, TileRect rect, int *value, int *mirror_value)
+{
+    int *iters = tile->job->iters;
+
+    *value = iters[tile_index(tile, rect.x0, rect.y0)];
+    *mirror_value = -1;
+
+    for (int y = rect.y0; y <= rect.y1; ++y) {
+        bool edge = (y == rect.y0 || y == rect.y1);
+
+        for (int x = rect.x0; x <= rect.x1; x += (edge ? 1 : rect.x1 - rect.x0)) {
+            int index = tile_index(tile, x, y);
+            if (iters[index] != *value) return false;
+            if (tile->job->glitched != NULL && tile->job->glitched[index]) return false;
+
+            int mirror = tile_mirror_index(tile, x, y);
+            if (mirror >= 0) {
+                if (*mirror_value < 0) *mirror_value = iters[mirror];
+                if (iters[mirror] != *mirror_value) return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+// Fraction of the smooth count of tile sample (x, y), or of its conjugate,
+// NaN when there is no conjugate
+static inline float tile_fraction(TileState *tile, int x, int y, bool mirror)
+{
+    int index = mirror ? tile_mirror_index(tile, x, y) : tile_index(tile, x, y);
+    if (index < 0) return NAN;
+
+    return tile->job->smooth[index] - tile->job->iters[index];
+}
+
+// Fraction of a sample filled inside a uniform rectangle, blended from the
+// border like a Coons patch (the blends across and down, less the bilinear
+// blend of the corners), so smooth colours carry on through the filled
+// rectangles. Conjugate rows that the top or bottom of the rectangle lacks
+// are blended across only.
+static float tile_fill_fraction(TileState *tile, TileRect rect, int x, int y, bool mirror)
+{
+    float u = (float)(x - rect.x0) / (rect.x1 - rect.x0);
+    float v = (float)(y - rect.y0) / (rect.y1 - rect.y0);
+    float left = tile_fraction(tile, rect.x0, y, mirror);
+    float right = tile_fraction(tile, rect.x1, y, mirror);
+    float across = (1 - u)*left + u*right;
+
+    float top = tile_fraction(tile, x, rect.y0, mirror);
+    float bottom = tile_fraction(tile, x, rect.y1, mirror);
+    float top_left = tile_fraction(tile, rect.x0, rect.y0, mirror);
+    float top_right = tile_fraction(tile, rect.x1, rect.y0, mirror);
+    float bottom_left = tile_fraction(tile, rect.x0, rect.y1, mirror);
+    float bottom_right = tile_fraction(tile, rect.x1, rect.y1, mirror);
+    if (isnan(top) || isnan(bottom)) return across;
+
+    return across + (1 - v)*top + v*bottom
+        - ((1 - v)*((1 - u)*top_left + u*top_right) + v*((1 - u)*bottom_left + u*bottom_right));
+}
+
+// Mariani-Silver subdivision. The border of every rectangle is computed; if
+// the whole border has the same iteration count the inside is filled with
+// it, otherwise the rectangle is split in four and each part is handled the
+// same way. All rectangles of one level are batched into a single kernel
+// call, so the SIMD lanes stay busy even for small borders.
+static void tile_subdivide(TileState *tile, int x0, int y0, int x1, int y1)
+{
+    // A level never holds more rectangles than fit in the tile with the
+    // minimum size
+    TileRect rects[2][(TILE_SIZE/SUBDIVIDE_MIN_SIZE + 1)*(TILE_SIZE/SUBDIVIDE_MIN_SIZE + 1)];
+    int rect_count = 1;
+    int level = 0;
+    rects[level][0] = (TileRect){ x0, y0, x1, y1 };
+
+    while (rect_count > 0) {
+        TileRect *current = rects[level];
+        TileRect *next = rects[!level];
+        int next_count = 0;
+
+        for (int r = 0; r < rect_count; ++r) {
+            TileRect rect = current[r];
+            for (int x = rect.x0; x <= rect.x1; ++x) {
+                tile_queue(tile, x, rect.y0);
+                tile_queue(tile, x, rect.y1);
+            }
+            for (int y = rect.y0 + 1; y < rect.y1; ++y) {
+                tile_queue(tile, rect.x0, y);
+                tile_queue(tile, rect.x1, y);
+            }
+        }
+        tile_flush(tile);
+
+        for (int r = 0; r < rect_count; ++r) {
+            TileRect rect = current[r];
+            if (rect.x1 - rect.x0 < 2 || rect.y1 - rect.y0 < 2) continue;
+
+            int value, mirror_value;
+            if (tile_rect_uniform(tile, rect, &value, &mirror_value)) {
+                for (int y = rect.y0 + 1; y < rect.y1; ++y) {
+                    for (int x = rect.x0 + 1; x < rect.x1; ++x) {
+                        int local = (x - tile->column_start) + (y - tile->row_start)*TILE_SIZE;
+                        if (tile->done[local]) continue;
+                        tile->done[local] = true;
+
+                        // A known sample still fills its conjugate if that is
+                        // not known, with its own count
+                        int index = tile_index(tile, x, y);
+                        int mirror = tile_mirror_index(tile, x, y);
+                        bool known = tile->job->known != NULL && tile->job->known[index];
+                        if (known && (mirror < 0 || tile->job->known[mirror])) continue;
+                        bool smooth = tile->job->smooth != NULL;
+                        if (!known) {
+                            tile_store(tile, index, value, smooth ? tile_fill_fraction(tile, rect, x, y, false) : 0.0f);
+                        }
+
+                        if (mirror >= 0) {
+                            if (known) {
+                                tile_store(tile, mirror, tile->job->iters[index],
+                                        smooth ? tile_fraction(tile, x, y, false) : 0.0f);
+                            } else {
+                                tile_store(tile, mirror, mirror_value,
+                                        smooth ? tile_fill_fraction(tile, rect, x, y, true) : 0.0f);
+                            }
+                            ++tile->mirrored;
+                        }
+                    }
+                }
+            } else if (rect.x1 - rect.x0 <= SUBDIVIDE_MIN_SIZE || rect.y1 - rect.y0 <= SUBDIVIDE_MIN_SIZE) {
+                for (int y = rect.y0 + 1; y < rect.y1; ++y) {
+                    for (int x = rect.x0 + 1; x < rect.x1; ++x) {
+                        tile_queue(tile, x, y);
+                    }
+                }
+            } else {
+                int xm = (rect.x0 + rect.x1) / 2;
+                int ym = (rect.y0 + rect.y1) / 2;
+                next[next_count++] = (TileRect){ rect.x0, rect.y0, xm, ym };
+                next[next_count++] = (TileRect){ xm, rect.y0, rect.x1, ym };
+                next[next_count++] = (TileRect){ rect.x0, ym, xm, rect.y1 };
+                next[next_count++] = (TileRect){ xm, ym, rect.x1, rect.y1 };
+            }
+        }
+
+        // Rectangles that are too small to split are computed along with
+        // the borders of the next level
+        level = !level;
+        rect_count = next_count;
+    }
+    tile_flush(tile);
+}
+
+static void render_tile(void *ctx, int index)
+{
+    RenderJob *job = (RenderJob*)ctx;
+    const RenderParams *params = job->params;
+
+    TileState tile;
+    tile.job = job;
+    tile.column_start = (index % job->tiles_x) * TILE_SIZE;
+    tile.row_start = (index / job->tiles_x) * TILE_SIZE;
+    tile.count = 0;
+    tile.mirror_count = 0;
+    tile.iterated = 0;
+    tile.interior_skipped = 0;
+    tile.mirrored = 0;
+    tile.kept_count = 0;
+    memset(tile.done, 0, sizeof(tile.done));
+
+    int columns = (job->columns + job->stride - 1) / job->stride;
+    int column_end = tile.column_start + TILE_SIZE;
+    int row_end = tile.row_start + TILE_SIZE;
+    if (column_end > columns) column_end = columns;
+    if (row_end > job->computed_count) row_end = job->computed_count;
+
+    if (params->generation != NULL && atomic_load(params->generation) != params->generation_id) {
+        atomic_store(&job->abandoned, true);
+    } else if (params->engine == ENGINE_SUBDIVIDE) {
+        tile_subdivide(&tile, tile.column_start, tile.row_start, column_end - 1, row_end - 1);
+    } else {
+        for (int row = tile.row_start; row < row_end; ++row) {
+            for (int column = tile.column_start; column < column_end; ++column) {
+                tile_queue(&tile, column, row);
+            }
+        }
+        tile_flush(&tile);
+    }
+
+    atomic_fetch_add(&job->iterated, tile.iterated);
+    atomic_fetch_add(&job->interior_skipped, tile.interior_skipped);
+    atomic_fetch_add(&job->mirrored, tile.mirrored);
+
+    // Room for a batch per tile was made before the pass
+    if (tile.kept_count > 0) {
+        RenderResumeBatch *batch = &job->resume->batches[atomic_fetch_add(&job->resume->batch_count, 1)];
+        size_t bytes = tile.kept_count * sizeof(*batch->zr);
+        batch->index = malloc(tile.kept_count * sizeof(*batch->index));
+        batch->zr = malloc(bytes);
+        batch->zi = malloc(bytes);
+        assert(batch->index != NULL && batch->zr != NULL && batch->zi != NULL);
+        memcpy(batch->index, tile.kept_index, tile.kept_count * sizeof(*batch->index));
+        memcpy(batch->zr, tile.kept_zr, bytes);
+        memcpy(batch->zi, tile.kept_zi, bytes);
+        batch->count = tile.kept_count;
+    }
+
+    int done = atomic_fetch_add(&job->tiles_done, 1) + 1;
+    if (params->progress != NULL) {
+        *params->progress = (real)done / (job->tiles_x * job->tiles_y) * 100.0;
+    }
+}
+
+static void render_scratch_reserve(RenderScratch *scratch, int columns, int rows)
+{
+    if (columns > scratch->columns) {
+        free(scratch->column_real);
+        scratch->column_real = malloc(columns * sizeof(*scratch->column_real));
+        assert(scratch->column_real != NULL);
+        scratch->columns = columns;
+    }
+    if (rows > scratch->rows) {
+        free(scratch->row_imag);
+        free(scratch->computed_rows);
+        free(scratch->mirror_row);
+        scratch->row_imag = malloc(rows * sizeof(*scratch->row_imag));
+        scratch->computed_rows = malloc(rows * sizeof(*scratch->computed_rows));
+        scratch->mirror_row = malloc(rows * sizeof(*scratch->mirror_row));
+        assert(scratch->row_imag != NULL && scratch->computed_rows != NULL && scratch->mirror_row != NULL);
+        scratch->rows = rows;
+    }
+}
+
+void render_scratch_free(RenderScratch *scratch)
+{
+    free(scratch->column_real);
+    free(scratch->row_imag);
+    free(scratch->computed_rows);
+    free(scratch->mirror_row);
+    reference_free(&scratch->reference);
+    bla_free(&scratch->bla);
+    free(scratch->glitched);
+    free(scratch->glitch_samples);
+    reference_free(&scratch->glitch_reference);
+    bla_free(&scratch->glitch_bla);
+    memset(scratch, 0, sizeof(*scratch));
+}
+
+void render_resume_forget(RenderResume *resume)
+{
+    int count = atomic_load(&resume->batch_count);
+    for (int i = 0; i < count; ++i) {
+        free(resume->batches[i].index);
+        free(resume->batches[i].zr);
+        free(resume->batches[i].zi);
+    }
+    atomic_store(&resume->batch_count, 0);
+    resume->precision = PRECISION_AUTO;
+}
+
+void render_resume_clear(RenderResume *resume)
+{
+    render_resume_forget(resume);
+    resume->iterations = 0;
+}
+
+void render_resume_free(RenderResume *resume)
+{
+    render_resume_clear(resume);
+    free(resume->batches);
+    resume->batches = NULL;
+    resume->batch_capacity = 0;
+}
+
+// Camera in full precision
+static void render_center(const RenderParams *params, MpVector2 *c)
+{
+    if (params->has_center) {
+        *c = params->center;
+    } else {
+        render_mp_from_real(&c->x, params->camera.x);
+        render_mp_from_real(&c->y, params->camera.y);
+    }
+}
+
+// Limbs of a reference orbit that resolves the sample spacing `step` of the
+// view with a limb to spare
+static int render_reference_limbs(const RenderParams *params, long double *step)
+{
+    long double step_x = 2.0L * params->scale.x * params->pixel_width / params->width;
+    long double step_y = 2.0L * params->scale.y * params->pixel_height / params->height;
+    *step = fminl(fabsl(step_x), fabsl(step_y));
+    int bits = (*step < 1.0L) ? (int)ceill(-log2l(*step)) : 0;
+
+    return mp_limbs_for_bits(bits + 64);
+}
+
+// Newton's method stops this far below the sample spacing
+#define RENDER_NUCLEUS_TOLERANCE 0x1p-32L
+
+bool render_nucleus(const RenderParams *params, MpVector2 *nucleus, int *period)
+{
+    MpVector2 camera;
+    long double step;
+    render_center(params, &camera);
+    int limbs = render_reference_limbs(params, &step);
+
+    return nucleus_locate(nucleus, period, &camera, fabsl((long double)params->scale.x),
+            fabsl((long double)params->scale.y), limbs, params->iterations, step * RENDER_NUCLEUS_TOLERANCE);
+}
+
+// Whether `c` lies in the view around `camera`
+static bool render_in_view(const RenderParams *params, const MpVector2 *camera, const MpVector2 *c, int limbs)
+{
+    MpFixed offset;
+
+    mp_sub(&offset, &c->x, &camera->x, limbs);
+    if (fabsl(mp_to_long_double(&offset, limbs)) > fabsl((long double)params->scale.x)) return false;
+    mp_sub(&offset, &c->y, &camera->y, limbs);
+
+    return fabsl(mp_to_long_double(&offset, limbs)) <= fabsl((long double)params->scale.y);
+}
+
+// Finds the nucleus for the reference of the view around `camera`, false
+// if there is none. The one found before is kept while it stays in view,
+// refined further when the view needs more limbs, and a view that had none
+// is not searched again.
+static bool render_reference_nucleus(RenderScratch *scratch, const RenderParams *params, const MpVector2 *camera,
+        int limbs, long double step)
+{
+    if (scratch->nucleus_limbs == limbs && scratch->nucleus_iterations == params->iterations
+            && scratch->nucleus_scale.x == params->scale.x && scratch->nucleus_scale.y == params->scale.y
+            && mp_equal(&scratch->nucleus_camera.x, &camera->x, MP_MAX_LIMBS)
+            && mp_equal(&scratch->nucleus_camera.y, &camera->y, MP_MAX_LIMBS)) {
+        return scratch->nucleus_period > 0;
+    }
+
+    long double tolerance = step * RENDER_NUCLEUS_TOLERANCE;
+    bool kept = scratch->nucleus_period > 0 && scratch->nucleus_period <= params->iterations
+        && render_in_view(params, camera, &scratch->nucleus, limbs)
+        && (scratch->nucleus_limbs >= limbs
+                || nucleus_newton(&scratch->nucleus, scratch->nucleus_period, limbs, tolerance));
+    if (!kept && !render_nucleus(params, &scratch->nucleus, &scratch->nucleus_period)) {
+        scratch->nucleus_period = 0;
+    }
+
+    if (!kept || scratch->nucleus_limbs < limbs) scratch->nucleus_limbs = limbs;
+    scratch->nucleus_camera = *camera;
+    scratch->nucleus_scale = params->scale;
+    scratch->nucleus_iterations = params->iterations;
+
+    return scratch->nucleus_period > 0;
+}
+
+// Orbit of `c` in `limbs` limbs, until it escapes or reaches iterations + 1
+// steps. Returns false if the one in the scratch is reused. With
+// `cache_reference` set it goes through the disk cache, `cached` gets what
+// the cache had.
+static bool render_reference(RenderScratch *scratch, const RenderParams *params, const MpVector2 *c, int limbs,
+        RefcacheResult *cached)
+{
+    ReferenceOrbit *reference = &scratch->reference;
+    MpVector2 z;
+    if (reference->length > 0 && mp_equal(&scratch->reference_center.x, &c->x, MP_MAX_LIMBS)
+            && mp_equal(&scratch->reference_center.y, &c->y, MP_MAX_LIMBS)
+            && scratch->reference_limbs >= limbs && scratch->reference_iterations >= params->iterations) {
+        return false;
+    }
+
+    int length = params->iterations + 2;
+    *cached = params->cache_reference ? refcache_load(reference, &z, c, limbs, length) : REFCACHE_OFF;
+    if (*cached == REFCACHE_PARTIAL) {
+        reference_extend(reference, c, &z, limbs, length);
+    } else if (*cached != REFCACHE_HIT) {
+        reference->length = 0;
+        reference_extend(reference, c, &z, limbs, length);
+    }
+    if (*cached == REFCACHE_PARTIAL || *cached == REFCACHE_MISS) {
+        refcache_store(reference, &z, c, limbs);
+    }
+    scratch->reference_center = *c;
+    scratch->reference_limbs = limbs;
+    scratch->reference_iterations = params->iterations;
+
+    return true;
+}
+
+// One extra reference and the glitched samples that are redone against it
+typedef struct {
+    RenderJob *job;
+    const ReferenceOrbit *reference;
+    const BlaTable *bla;
+    FloatExp dcr; // Offset of the reference from the camera
+    FloatExp dci;
+    const int *samples;
+    int count;
+} GlitchJob;
+
+static void render_glitch_chunk(void *ctx, int chunk)
+{
+    GlitchJob *glitch = (GlitchJob*)ctx;
+    RenderJob *job = glitch->job;
+    int begin = chunk * TILE_SIZE*TILE_SIZE;
+    int end = (begin + TILE_SIZE*TILE_SIZE < glitch->count) ? begin + TILE_SIZE*TILE_SIZE : glitch->count;
+
+    union {
+        double d[TILE_SIZE*TILE_SIZE];
+        FloatExp fe[TILE_SIZE*TILE_SIZE];
+    } cr, ci;
+    int mirror_index[TILE_SIZE*TILE_SIZE];
+    int results[TILE_SIZE*TILE_SIZE];
+    int mirror_results[TILE_SIZE*TILE_SIZE];
+    float fractions[TILE_SIZE*TILE_SIZE];
+    float mirror_fractions[TILE_SIZE*TILE_SIZE];
+    uint8_t glitched[TILE_SIZE*TILE_SIZE];
+    int count = end - begin;
+    bool mirrors = false;
+
+    for (int k = 0; k < count; ++k) {
+        int index = glitch->samples[begin + k];
+        int column = index % job->columns;
+        int row = index / job->columns;
+        FloatExp dr = fe_sub(job->column_real[column].delta, glitch->dcr);
+        FloatExp di = fe_sub(job->row_imag[row].delta, glitch->dci);
+        if (job->extended) {
+            cr.fe[k] = dr;
+            ci.fe[k] = di;
+        } else {
+            cr.d[k] = fe_to_double(dr);
+            ci.d[k] = fe_to_double(di);
+        }
+
+        int mirror = job->mirror_row[row];
+        mirror_index[k] = (mirror >= 0) ? column + mirror*job->columns : -1;
+        mirrors |= (mirror >= 0);
+    }
+
+    int iterations = job->params->iterations;
+    int *out_mirror = mirrors ? mirror_results : NULL;
+    if (job->extended) {
+        perturb_floatexp(glitch->reference, glitch->bla, cr.fe, ci.fe, count, iterations, results, out_mirror,
+                fractions, mirror_fractions, glitched);
+    } else {
+        perturb_double(glitch->reference, glitch->bla, cr.d, ci.d, count, iterations, results, out_mirror,
+                fractions, mirror_fractions, glitched);
+    }
+
+    // Samples that are still glitched keep the count they had
+    for (int k = 0; k < count; ++k) {
+        if (glitched[k]) continue;
+
+        int index = glitch->samples[begin + k];
+        job->iters[index] = results[k];
+        if (job->smooth != NULL) job->smooth[index] = smooth_count(results[k], fractions[k], iterations);
+        if (mirror_index[k] >= 0) {
+            job->iters[mirror_index[k]] = mirror_results[k];
+            if (job->smooth != NULL) {
+                job->smooth[mirror_index[k]] = smooth_count(mirror_results[k], mirror_fractions[k], iterations);
+            }
+        }
+        job->glitched[index] = 0;
+    }
+}
+
+// Glitched samples counted with the conjugates they fill
+static long render_glitch_samples(const RenderJob *job, const int *samples, int count)
+{
+    long total = count;
+
+    for (int k = 0; k < count; ++k) {
+        total += (job->mirror_row[samples[k] / job->columns] >= 0);
+    }
+
+    return total;
+}
+
+// Redoes the glitched samples against extra references, each one placed at
+// the glitched sample nearest to the middle of those that are left, which
+// lands it inside the largest glitched area. Only the glitched samples are
+// iterated again, a sample counts as corrected once a reference gets it
+// through without a glitch.
+static void render_correct_glitches(ThreadPool *pool, RenderJob *job, RenderScratch *scratch, int limbs,
+        long *glitched, long *corrected)
+{
+    const RenderParams *params = job->params;
+    int *samples = job->glitch_samples;
+    int count = atomic_load(&job->glitch_count);
+
+    *glitched = render_glitch_samples(job, samples, count);
+    *corrected = 0;
+
+    for (int round = 0; round < RENDER_GLITCH_REFERENCES && count > 0; ++round) {
+        if (params->generation != NULL && atomic_load(params->generation) != params->generation_id) {
+            atomic_store(&job->abandoned, true);
+            return;
+        }
+
+        double middle_x = 0.0;
+        double middle_y = 0.0;
+        for (int k = 0; k < count; ++k) {
+            middle_x += samples[k] % job->columns;
+            middle_y += samples[k] / job->columns;
+        }
+        middle_x /= count;
+        middle_y /= count;
+
+        int chosen = samples[0];
+        double nearest = INFINITY;
+        for (int k = 0; k < count; ++k) {
+            double dx = samples[k] % job->columns - middle_x;
+            double dy = samples[k] / job->columns - middle_y;
+            if (dx*dx + dy*dy < nearest) {
+                nearest = dx*dx + dy*dy;
+                chosen = samples[k];
+            }
+        }
+
+        GlitchJob glitch = {
+            .job = job,
+            .reference = &scratch->glitch_reference,
+            .dcr = job->column_real[chosen % job->columns].delta,
+            .dci = job->row_imag[chosen / job->columns].delta,
+            .samples = samples,
+            .count = count,
+        };
+
+        MpVector2 c = scratch->reference_center;
+        MpFixed offset;
+        mp_from_long_double(&offset, ldexpl(glitch.dcr.m, glitch.dcr.e));
+        mp_add(&c.x, &c.x, &offset, MP_MAX_LIMBS);
+        mp_from_long_double(&offset, ldexpl(glitch.dci.m, glitch.dci.e));
+        mp_add(&c.y, &c.y, &offset, MP_MAX_LIMBS);
+        reference_compute(&scratch->glitch_reference, &c, limbs, params->iterations + 2);
+        if (job->bla != NULL) {
+            // The samples lie up to the whole view away from this reference
+            bla_build(&scratch->glitch_bla, &scratch->glitch_reference, scratch->bla_epsilon, 2.0*scratch->bla_radius);
+            glitch.bla = &scratch->glitch_bla;
+        }
+
+        pool_run(pool, (count + TILE_SIZE*TILE_SIZE - 1) / (TILE_SIZE*TILE_SIZE), render_glitch_chunk, &glitch);
+
+        long before = render_glitch_samples(job, samples, count);
+        int left = 0;
+        for (int k = 0; k < count; ++k) {
+            if (job->glitched[samples[k]]) samples[left++] = samples[k];
+        }
+        *corrected += before - render_glitch_samples(job, samples, left);
+        count = left;
+    }
+}
+
+// A pass over the samples the parameters ask for
+static bool render_pass(ThreadPool *pool, const EscapeKernels *kernels, const RenderParams *params,
+        int *iters, RenderStats *stats)
+{
+    RenderJob job = {
+        .params = params,
+        .kernels = kernels,
+        .iters = iters,
+        .smooth = params->smooth,
+        .known = params->known,
+        .columns = render_columns(params),
+        .rows = render_rows(params),
+        .stride = (params->stride > 1) ? params->stride : 1,
+        .precision = render_select_precision(kernels, params),
+    };
+
+    RenderScratch local = { 0 };
+    RenderScratch *scratch = (params->scratch != NULL) ? params->scratch : &local;
+    render_scratch_reserve(scratch, job.columns, job.rows);
+    job.column_real = scratch->column_real;
+    job.row_imag = scratch->row_imag;
+    job.computed_rows = scratch->computed_rows;
+    job.mirror_row = scratch->mirror_row;
+    render_setup_grid(&job);
+
+    int limbs = 0;
+    int nucleus_period = 0;
+    RefcacheResult cached = REFCACHE_OFF;
+    atomic_init(&job.glitch_count, 0);
+    if (job.precision == PRECISION_PERTURBATION) {
+        long double step;
+        limbs = render_reference_limbs(params, &step);
+
+        MpVector2 camera;
+        render_center(params, &camera);
+        bool nucleus = params->reference_nucleus && render_reference_nucleus(scratch, params, &camera, limbs, step);
+        bool computed = render_reference(scratch, params, nucleus ? &scratch->nucleus : &camera, limbs, &cached);
+        job.reference = &scratch->reference;
+        if (nucleus) {
+            // The grid offsets are taken from the nucleus instead, which the
+            // extra references for glitches go on from as well
+            MpFixed offset;
+            mp_sub(&offset, &scratch->nucleus.x, &camera.x, limbs);
+            FloatExp dcr = fe_from_long_double(mp_to_long_double(&offset, limbs));
+            mp_sub(&offset, &scratch->nucleus.y, &camera.y, limbs);
+            FloatExp dci = fe_from_long_double(mp_to_long_double(&offset, limbs));
+            for (int column = 0; column < job.columns; ++column) {
+                job.column_real[column].delta = fe_sub(job.column_real[column].delta, dcr);
+            }
+            for (int row = 0; row < job.rows; ++row) {
+                job.row_imag[row].delta = fe_sub(job.row_imag[row].delta, dci);
+            }
+            nucleus_period = scratch->nucleus_period;
+        }
+
+        // Samples lie up to the whole view away from a nucleus
+        double epsilon = (params->bla_epsilon != 0.0) ? params->bla_epsilon : BLA_EPSILON;
+        double radius = hypot((double)params->scale.x, (double)params->scale.y) * (nucleus ? 2.0 : 1.0);
+        if (epsilon > 0.0) {
+            if (computed || scratch->bla_epsilon != epsilon || scratch->bla_radius != radius) {
+                bla_build(&scratch->bla, &scratch->reference, epsilon, radius);
+                scratch->bla_epsilon = epsilon;
+                scratch->bla_radius = radius;
+            }
+            job.bla = &scratch->bla;
+        }
+
+        job.extended = step < PERTURB_EXTENDED_STEP;
+
+        int samples = job.columns * job.rows;
+        if (samples > scratch->glitch_capacity) {
+            free(scratch->glitched);
+            free(scratch->glitch_samples);
+            scratch->glitched = malloc(samples * sizeof(*scratch->glitched));
+            scratch->glitch_samples = malloc(samples * sizeof(*scratch->glitch_samples));
+            assert(scratch->glitched != NULL && scratch->glitch_samples != NULL);
+            scratch->glitch_capacity = samples;
+        }
+        job.glitched = scratch->glitched;
+        job.glitch_samples = scratch->glitch_samples;
+    }
+
+    int strided_columns = (job.columns + job.stride - 1) / job.stride;
+    job.tiles_x = (strided_columns + TILE_SIZE - 1) / TILE_SIZE;
+    job.tiles_y = (job.computed_count + TILE_SIZE - 1) / TILE_SIZE;
+
+    // Subdivision fills samples it never iterated, so only the pixel engine
+    // has the orbits of all samples at the limit
+    RenderResume *resume = params->resume;
+    if (resume != NULL) {
+        job.capture = params->engine == ENGINE_PIXEL && (job.precision == PRECISION_FLOAT
+                || job.precision == PRECISION_DOUBLE);
+        Precision kept = job.capture ? job.precision : PRECISION_AUTO;
+        if (resume->iterations != params->iterations) {
+            render_resume_clear(resume);
+            resume->iterations = params->iterations;
+            resume->precision = kept;
+        } else if (resume->precision != kept) {
+            // Other passes at this limit kept other orbits or none, so they
+            // are not all there
+            render_resume_forget(resume);
+        }
+        job.capture = job.capture && resume->precision == job.precision;
+
+        int needed = atomic_load(&resume->batch_count) + job.tiles_x * job.tiles_y;
+        if (job.capture && needed > resume->batch_capacity) {
+            resume->batches = realloc(resume->batches, needed * sizeof(*resume->batches));
+            assert(resume->batches != NULL);
+            resume->batch_capacity = needed;
+        }
+        job.resume = resume;
+    }
+    atomic_init(&job.tiles_done, 0);
+    atomic_init(&job.abandoned, false);
+    atomic_init(&job.iterated, 0);
+    atomic_init(&job.interior_skipped, 0);
+    atomic_init(&job.mirrored, 0);
+    atomic_init(&job.resumed, 0);
+
+    pool_run(pool, job.tiles_x * job.tiles_y, render_tile, &job);
+
+    long glitched = 0;
+    long corrected = 0;
+    if (job.precision == PRECISION_PERTURBATION && !atomic_load(&job.abandoned)) {
+        render_correct_glitches(pool, &job, scratch, limbs, &glitched, &corrected);
+    }
+    // Some tiles were skipped and kept nothing
+    if (resume != NULL && atomic_load(&job.abandoned)) {
+        render_resume_clear(resume);
+    }
+
+    if (stats != NULL) {
+        stats->precision = job.precision;
+        stats->samples = (long)strided_columns * job.computed_count;
+        stats->iterated = atomic_load(&job.iterated);
+        stats->interior_skipped = atomic_load(&job.interior_skipped);
+        stats->mirrored = atomic_load(&job.mirrored);
+        stats->glitched = glitched;
+        stats->corrected = corrected;
+        stats->resumed = 0;
+        stats->orbit_hits = (cached == REFCACHE_HIT);
+        stats->orbit_extended = (cached == REFCACHE_PARTIAL);
+        stats->orbit_misses = (cached == REFCACHE_MISS);
+        stats->nucleus_period = nucleus_period;
+    }
+
+    render_scratch_free(&local);
+
+    return !atomic_load(&job.abandoned);
+}
+
+// Carries on the orbits of one batch, and drops those that escape now
+static void render_resume_batch(void *ctx, int index)
+{
+    RenderJob *job = (RenderJob*)ctx;
+    const RenderParams *params = job->params;
+    RenderResumeBatch *batch = &job->resume->batches[index];
+    int from = job->resume->iterations;
+
+    if (params->generation != NULL && atomic_load(params->generation) != params->generation_id) {
+        atomic_store(&job->abandoned, true);
+        return;
+    }
+
+    union {
+        float f[TILE_SIZE*TILE_SIZE];
+        double d[TILE_SIZE*TILE_SIZE];
+    } cr, ci, zr, zi;
+    int results[TILE_SIZE*TILE_SIZE];
+    int mirror_results[TILE_SIZE*TILE_SIZE];
+    float fractions[TILE_SIZE*TILE_SIZE];
+    float mirror_fractions[TILE_SIZE*TILE_SIZE];
+    int mirror_index[TILE_SIZE*TILE_SIZE];
+    bool mirrors = false;
+    long iterated = 0;
+
+    for (int k = 0; k < batch->count; ++k) {
+        int sample = batch->index[k];
+        iterated += !isnan(batch->zr[k]);
+        int column = sample % job->columns;
+        int mirror = job->mirror_row[sample / job->columns];
+
+        // Samples without a conjugate in view have no count to carry on
+        mirror_index[k] = (mirror >= 0) ? column + mirror*job->columns : -1;
+        results[k] = job->iters[sample];
+        mirror_results[k] = (mirror >= 0) ? job->iters[mirror_index[k]] : -1;
+        mirrors |= mirror >= 0;
+
+        if (job->precision == PRECISION_FLOAT) {
+            cr.f[k] = job->column_real[column].f;
+            ci.f[k] = job->row_imag[sample / job->columns].f;
+            zr.f[k] = batch->zr[k];
+            zi.f[k] = batch->zi[k];
+        } else {
+            cr.d[k] = job->column_real[column].d;
+            ci.d[k] = job->row_imag[sample / job->columns].d;
+            zr.d[k] = batch->zr[k];
+            zi.d[k] = batch->zi[k];
+        }
+    }
+
+    // Counts that stay at the limit keep a fraction of 0
+    for (int k = 0; k < batch->count; ++k) fractions[k] = mirror_fractions[k] = 0.0f;
+    if (job->precision == PRECISION_FLOAT) {
+        job->kernels->resume_float(cr.f, ci.f, zr.f, zi.f, batch->count, from, params->iterations,
+                results, mirrors ? mirror_results : NULL, fractions, mirror_fractions);
+    } else {
+        job->kernels->resume_double(cr.d, ci.d, zr.d, zi.d, batch->count, from, params->iterations,
+                results, mirrors ? mirror_results : NULL, fractions, mirror_fractions);
+    }
+
+    int kept = 0;
+    for (int k = 0; k < batch->count; ++k) {
+        int sample = batch->index[k];
+        if (job->smooth != NULL && job->iters[sample] == from) {
+            job->smooth[sample] = smooth_count(results[k], fractions[k], params->iterations);
+        }
+        job->iters[sample] = results[k];
+        if (mirror_index[k] >= 0) {
+            if (job->smooth != NULL && job->iters[mirror_index[k]] == from) {
+                job->smooth[mirror_index[k]] = smooth_count(mirror_results[k], mirror_fractions[k], params->iterations);
+            }
+            job->iters[mirror_index[k]] = mirror_results[k];
+        }
+
+        if (results[k] == params->iterations || (mirror_index[k] >= 0 && mirror_results[k] == params->iterations)) {
+            batch->index[kept] = batch->index[k];
+            batch->zr[kept] = (job->precision == PRECISION_FLOAT) ? zr.f[k] : zr.d[k];
+            batch->zi[kept] = (job->precision == PRECISION_FLOAT) ? zi.f[k] : zi.d[k];
+            ++kept;
+        }
+    }
+
+    atomic_fetch_add(&job->iterated, iterated);
+    atomic_fetch_add(&job->resumed, batch->count);
+    batch->count = kept;
+}
+
+// Raises the limit of the kept render by carrying on its orbits
+static bool render_resume_orbits(ThreadPool *pool, const EscapeKernels *kernels, const RenderParams *params,
+        int *iters, RenderStats *stats)
+{
+    RenderResume *resume = params->resume;
+    RenderJob job = {
+        .params = params,
+        .kernels = kernels,
+        .iters = iters,
+        .smooth = params->smooth,
+        .columns = render_columns(params),
+        .rows = render_rows(params),
+        .stride = 1,
+        .precision = resume->precision,
+        .resume = resume,
+    };
+
+    RenderScratch local = { 0 };
+    RenderScratch *scratch = (params->scratch != NULL) ? params->scratch : &local;
+    render_scratch_reserve(scratch, job.columns, job.rows);
+    job.column_real = scratch->column_real;
+    job.row_imag = scratch->row_imag;
+    job.computed_rows = scratch->computed_rows;
+    job.mirror_row = scratch->mirror_row;
+    render_setup_grid(&job);
+
+    atomic_init(&job.abandoned, false);
+    atomic_init(&job.iterated, 0);
+    atomic_init(&job.resumed, 0);
+    pool_run(pool, atomic_load(&resume->batch_count), render_resume_batch, &job);
+
+    // Batches that were skipped stay at the old limit
+    bool completed = !atomic_load(&job.abandoned);
+    if (completed) {
+        resume->iterations = params->iterations;
+    } else {
+        render_resume_clear(resume);
+    }
+
+    if (stats != NULL) {
+        memset(stats, 0, sizeof(*stats));
+        stats->precision = job.precision;
+        stats->samples = (long)job.columns * job.rows;
+        stats->iterated = atomic_load(&job.iterated);
+        stats->resumed = atomic_load(&job.resumed);
+    }
+
+    render_scratch_free(&local);
+
+    return completed;
+}
+
+bool render_iterations(ThreadPool *pool, const EscapeKernels *kernels, const RenderParams *params,
+        int *iters, RenderStats *stats)
+{
+    RenderResume *resume = params->resume;
+    if (resume == NULL || resume->iterations <= 0 || resume->iterations >= params->iterations) {
+        return render_pass(pool, kernels, params, iters, stats);
+    }
+
+    if (resume->precision != PRECISION_AUTO && resume->precision == render_select_precision(kernels, params)) {
+        return render_resume_orbits(pool, kernels, params, iters, stats);
+    }
+
+    // Without orbits the samples at the limit start over, all of them in one
+    // pass with the pixel engine. Samples that are paired with a conjugate
+    // at the limit are redone as well, they fill it.
+    int from = resume->iterations;
+    int samples = render_columns(params) * render_rows(params);
+    uint8_t *known = malloc(samples * sizeof(*known));
+    assert(known != NULL);
+    for (int i = 0; i < samples; ++i) known[i] = iters[i] != from;
+
+    RenderParams pass = *params;
+    pass.engine = ENGINE_PIXEL;
+    pass.stride = 1;
+    pass.row_begin = 0;
+    pass.row_end = 0;
+    pass.known = known;
+    render_resume_clear(resume);
+
+    bool completed = render_pass(pool, kernels, &pass, iters, stats);
+    if (stats != NULL) stats->resumed = stats->iterated;
+
+    free(known);
+
+    return completed;
+}
@@ -0,0 +1,245 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "kernel.h"
+#include "nucleus.h"
+#include "perturb.h"
+#include "pool.h"
+#include "refcache.h"
+
+#define TILE_SIZE 32
+#define SUBDIVIDE_MIN_SIZE 4
+#define RENDER_GLITCH_REFERENCES 8 // Extra references per perturbation pass
+
+// Type of the view state and of the sample grid. The kernels get the
+// coordinates in the precision picked for each render, this only bounds how
+// deep that precision can go. Defaults to the widest type the compiler has,
+// build with REAL=double (or float) to change it.
+#ifndef REAL
+#ifdef __SIZEOF_FLOAT128__
+#define REAL __float128
+#else
+#define REAL long double
+#endif
+#endif
+typedef REAL real;
+
+typedef struct {
+    real x;
+    real y;
+} Vector2Real;
+
+// Floating point type the escape kernels run in
+typedef enum {
+    PRECISION_AUTO = 0, // Cheapest type that resolves the sample spacing
+    PRECISION_FLOAT,
+    PRECISION_DOUBLE,
+    PRECISION_LONG_DOUBLE,
+    PRECISION_DOUBLE_DOUBLE,
+    PRECISION_FIXED, // 128-bit fixed point, the same bits on every host
+    PRECISION_PERTURBATION, // Double offsets from a reference orbit
+    PRECISION_COUNT,
+} Precision;
+
+// Automatic precision keeps this many spare bits below the sample spacing,
+// times the iteration count over PRECISION_ITERATIONS where it is larger.
+// A precision picked on the way in is only given up for a cheaper one once
+// the view resolves with PRECISION_HYSTERESIS times that margin.
+#define PRECISION_MARGIN 256.0
+#define PRECISION_ITERATIONS 1000
+#define PRECISION_HYSTERESIS 4.0
+
+typedef enum {
+    ENGINE_PIXEL = 0, // Iterate every sample
+    ENGINE_SUBDIVIDE, // Mariani-Silver rectangle subdivision
+    ENGINE_COUNT,
+} RenderEngine;
+
+// A grid coordinate in every precision the kernels take
+typedef struct {
+    float f;
+    double d;
+    long double ld;
+    DoubleDouble dd;
+    Fixed128 fx;
+    FloatExp delta; // Offset from the camera, for perturbation
+} RenderCoordinate;
+
+// Per view buffers of render_iterations(), kept by callers that render many
+// passes so they are not allocated every time
+typedef struct {
+    RenderCoordinate *column_real;
+    RenderCoordinate *row_imag;
+    int *computed_rows;
+    int *mirror_row;
+    int columns;
+    int rows;
+
+    // Reference orbit of the last perturbation render, reused as long as
+    // the camera stays put and neither the precision nor the iteration
+    // count grow
+    ReferenceOrbit reference;
+    MpVector2 reference_center;
+    int reference_limbs;
+    int reference_iterations;
+
+    // Nucleus the reference was placed on, period 0 for none, and the view
+    // it was searched in. It is kept while it stays in view, so panning
+    // around it keeps the orbit too.
+    MpVector2 nucleus;
+    int nucleus_period;
+    int nucleus_limbs;
+    MpVector2 nucleus_camera;
+    Vector2Real nucleus_scale;
+    int nucleus_iterations;
+
+    // BLA table of that orbit, which also depends on the size of the view
+    BlaTable bla;
+    double bla_epsilon;
+    double bla_radius;
+
+    // Glitched samples of the current pass, a flag per sample and the list
+    // of them, and the extra reference they are redone against
+    uint8_t *glitched;
+    int *glitch_samples;
+    int glitch_capacity;
+    ReferenceOrbit glitch_reference;
+    BlaTable glitch_bla;
+} RenderScratch;
+
+// Orbits of a render that reached its iteration limit, z and all, so a
+// higher limit only carries them on instead of starting every sample over.
+// Each tile of the render leaves a batch with the samples it had at the
+// limit. Orbits are only kept by the pixel engine in float and double
+// precision, the others leave just the limit to raise from.
+typedef struct {
+    int *index;  // Sample, row major
+    double *zr;  // z after `iterations` steps, NaN for periodic orbits and
+    double *zi;  // samples inside the main cardioid and bulb
+    int count;
+} RenderResumeBatch;
+
+typedef struct {
+    int iterations;      // Limit of the kept counts, 0 for none
+    Precision precision; // Of the orbits, PRECISION_AUTO when none are kept
+    RenderResumeBatch *batches;
+    atomic_int batch_count;
+    int batch_capacity;
+} RenderResume;
+
+typedef struct {
+    Vector2Real camera;
+    Vector2Real scale;
+    // Camera in full precision, for zooms deeper than `real` can pan in.
+    // The reference orbit starts here when `has_center` is set and at
+    // `camera` otherwise, unless it goes on a nucleus.
+    bool has_center;
+    MpVector2 center;
+    int width;
+    int height;
+    int pixel_width;  // Each sample covers pixel_width x pixel_height pixels
+    int pixel_height;
+    int iterations;
+    RenderEngine engine;
+    Precision precision;
+    double bla_epsilon; // Error bound of BLA skipping with perturbation, 0 for
+                        // BLA_EPSILON and negative to iterate every step
+    bool symmetry; // Mirror the rows that have a conjugate in view
+    bool cache_reference; // Keep the reference orbit in the disk cache
+    bool reference_nucleus; // Start the reference orbit on the nucleus of
+                            // lowest period in view rather than the camera
+    int *progress; // Percentage of finished tiles, may be NULL
+    // Gets the smooth count (count + escape_fraction(), see kernel.h) of
+    // every sample `iters` gets, and has to hold the counts of the samples
+    // a pass keeps. May be NULL.
+    float *smooth;
+
+    // Optional partial passes over the sample grid: only every stride-th
+    // column and row in [row_begin, row_end) is computed (0 means up to the
+    // last row). Samples whose `known` entry is set are kept as they are,
+    // computed ones get it set.
+    int stride;
+    int row_begin;
+    int row_end;
+    uint8_t *known;
+    RenderScratch *scratch; // May be NULL
+
+    // Samples at the limit, may be NULL. A pass at the limit of `resume`
+    // adds the orbits it leaves there, one at another limit starts it over.
+    // A pass at a higher limit than a nonzero `resume->iterations` raises
+    // the limit instead: `iters` must hold the complete render it was kept
+    // with, and only its samples at the limit are iterated on, from where
+    // they stopped when the orbits were kept. Callers clear it whenever the
+    // view changes, and forget the orbits when they move samples around.
+    RenderResume *resume;
+
+    // Tiles that have not started yet are skipped once `*generation` no
+    // longer equals `generation_id`. May be NULL.
+    const atomic_uint *generation;
+    unsigned generation_id;
+} RenderParams;
+
+typedef struct {
+    Precision precision;   // Precision the pass ran in, never PRECISION_AUTO
+    long samples;          // Samples that were part of the pass
+    long iterated;         // Samples that went through an escape kernel
+    long interior_skipped; // Samples inside the main cardioid or bulb
+    long mirrored;         // Samples copied from their conjugate
+    long glitched;         // Perturbation samples that lost precision
+    long corrected;        // Glitched samples redone without a glitch
+    long resumed;          // Samples carried on from a lower limit
+    long orbit_hits;       // Reference orbits loaded from the disk cache,
+    long orbit_extended;   // loaded and extended,
+    long orbit_misses;     // or computed and stored
+    int nucleus_period;    // Of the nucleus the reference sits on, 0 for none
+} RenderStats;
+
+real map(real value, real inputStart, real inputEnd, real outputStart, real outputEnd);
+
+// Exact conversion into fixed point, and the nearest `real` back
+void render_mp_from_real(MpFixed *r, real value);
+real render_real_from_mp(const MpFixed *a);
+
+int render_columns(const RenderParams *params);
+int render_rows(const RenderParams *params);
+// Whether two views have the same sample spacing and are rendered the same
+// way, so they only differ by where the camera is
+bool render_same_spacing(const RenderParams *a, const RenderParams *b);
+// Whether the real axis is in view, which lays the rows out around it, and
+// twice the row it falls on, rounded
+bool render_axis_row(const RenderParams *params, long *axis_row2);
+// Camera of `to` from the camera of `from`, in samples of `from`. When they
+// are whole, sample (column, row) of `to` is sample (column + columns,
+// row + rows) of `from`.
+void render_grid_offset(const RenderParams *from, const RenderParams *to, long double *columns, long double *rows);
+const char *render_engine_name(RenderEngine engine);
+const char *render_precision_name(Precision precision);
+Precision render_select_precision(const EscapeKernels *kernels, const RenderParams *params);
+// Same with hysteresis around `previous`, the precision of the last view
+// (PRECISION_AUTO for none), so zooming across a threshold does not flap
+Precision render_select_precision_from(const EscapeKernels *kernels, const RenderParams *params, Precision previous);
+// Whether a type of machine epsilon `epsilon` resolves the samples of the
+// view with `slack` times the margin of automatic precision
+bool render_precision_resolves(const RenderParams *params, long double epsilon, double slack);
+void render_scratch_free(RenderScratch *scratch);
+// Drops the kept orbits and the limit they were kept at
+void render_resume_clear(RenderResume *resume);
+// Drops the orbits only, raising the limit then starts the samples at it over
+void render_resume_forget(RenderResume *resume);
+void render_resume_free(RenderResume *resume);
+
+// Nucleus of lowest period inside the view, refined well below the sample
+// spacing. False if the view has none up to the iteration count.
+bool render_nucleus(const RenderParams *params, MpVector2 *nucleus, int *period);
+
+// Fills `iters` (render_columns() x render_rows() entries, row major) with
+// the escape iteration count of every sample of the pass. Returns false if
+// the pass was abandoned because its generation changed.
+bool render_iterations(ThreadPool *pool, const EscapeKernels *kernels, const RenderParams *params,
+        int *iters, RenderStats *stats);
+
+#endif // RENDER_H
@@ -0,0 +1,306 @@
+// Frame times of the two shader variants, mandelbrot.frag (float) and
+// mandelbrot_df.frag (double-float), rendered offscreen without a window. The
+// context comes from surfaceless EGL, so it also runs headless on Mesa's
+// llvmpipe. Every frame is read back and checked against the double-double
+// CPU kernel to show where the float shader breaks down.
+//
+// Usage: ./shaderbench [-i iterations] [-s size]
+
+#define GL_GLEXT_PROTOTYPES
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GL/gl.h>
+#include <GL/glext.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "kernel.h"
+
+#define BENCH_RUNS 3
+
+typedef struct {
+    const char *name;
+    long double camera_x;
+    long double camera_y;
+    long double scale;
+} ShaderView;
+
+static const ShaderView views[] = {
+    { "shallow", -0.5L, 0.0L, 2.0L },
+    { "deep", -0.743643887037151L, 0.131825904205330L, 1e-9L },
+};
+
+typedef struct {
+    const char *name;
+    const char *path;
+    bool split; // Camera and scale are passed as hi/lo pairs
+    GLuint program;
+} ShaderVariant;
+
+static double bench_now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+static char *read_file(const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) return NULL;
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    char *text = malloc(size + 1);
+    if (text != NULL) {
+        size_t read = fread(text, 1, size, file);
+        text[read] = '\0';
+    }
+    fclose(file);
+
+    return text;
+}
+
+static GLuint compile_shader(GLenum type, const char *path)
+{
+    char *source = read_file(path);
+    if (source == NULL) {
+        fprintf(stderr, "ERROR: Could not read %s\n", path);
+        return 0;
+    }
+
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, (const GLchar *const *)&source, NULL);
+    glCompileShader(shader);
+    free(source);
+
+    GLint status;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if (!status) {
+        char log[4096];
+        glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+        fprintf(stderr, "ERROR: Could not compile %s:\n%s\n", path, log);
+        glDeleteShader(shader);
+        return 0;
+    }
+
+    return shader;
+}
+
+static GLuint load_program(const char *vertex_path, const char *fragment_path)
+{
+    GLuint vertex = compile_shader(GL_VERTEX_SHADER, vertex_path);
+    GLuint fragment = compile_shader(GL_FRAGMENT_SHADER, fragment_path);
+    if (vertex == 0 || fragment == 0) return 0;
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertex);
+    glAttachShader(program, fragment);
+    glBindAttribLocation(program, 0, "vertexPosition");
+    glLinkProgram(program);
+    glDeleteShader(vertex);
+    glDeleteShader(fragment);
+
+    GLint status;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (!status) {
+        char log[4096];
+        glGetProgramInfoLog(program, sizeof(log), NULL, log);
+        fprintf(stderr, "ERROR: Could not link %s:\n%s\n", fragment_path, log);
+        glDeleteProgram(program);
+        return 0;
+    }
+
+    return program;
+}
+
+static bool create_context(void)
+{
+    PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    EGLDisplay display = EGL_NO_DISPLAY;
+    if (get_platform_display != NULL) {
+        display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    }
+    if (display == EGL_NO_DISPLAY) display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL)) return false;
+    if (!eglBindAPI(EGL_OPENGL_API)) return false;
+
+    const EGLint attributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE,
+    };
+    EGLContext context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attributes);
+    if (context == EGL_NO_CONTEXT) return false;
+
+    return eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context);
+}
+
+static void set_uniforms(const ShaderVariant *variant, const ShaderView *view, int size, int iterations)
+{
+    GLuint program = variant->program;
+    glUseProgram(program);
+
+    const GLfloat identity[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+    glUniformMatrix4fv(glGetUniformLocation(program, "mvp"), 1, GL_FALSE, identity);
+    glUniform2f(glGetUniformLocation(program, "u_Resolution"), size, size);
+    glUniform1i(glGetUniformLocation(program, "u_Iterations"), iterations);
+
+    // Same split as main.c, hi is the nearest float and lo the remainder
+    float camera_x = (float)view->camera_x;
+    float camera_y = (float)view->camera_y;
+    float scale = (float)view->scale;
+    if (variant->split) {
+        glUniform2f(glGetUniformLocation(program, "u_CameraHi"), camera_x, camera_y);
+        glUniform2f(glGetUniformLocation(program, "u_CameraLo"),
+                (float)(view->camera_x - camera_x), (float)(view->camera_y - camera_y));
+        glUniform2f(glGetUniformLocation(program, "u_ScaleHi"), scale, scale);
+        glUniform2f(glGetUniformLocation(program, "u_ScaleLo"),
+                (float)(view->scale - scale), (float)(view->scale - scale));
+    } else {
+        glUniform2f(glGetUniformLocation(program, "u_Camera"), camera_x, camera_y);
+        glUniform2f(glGetUniformLocation(program, "u_Scale"), scale, scale);
+    }
+}
+
+// Iteration counts at the pixel centres the shaders sample, from the
+// double-double kernel. Row 0 is the bottom row as read back by OpenGL.
+static void reference_iterations(const EscapeKernels *kernels, const ShaderView *view, int size,
+        int iterations, int *iters)
+{
+    DoubleDouble *cr = malloc(size * sizeof(*cr));
+    DoubleDouble *ci = malloc(size * sizeof(*ci));
+
+    for (int row = 0; row < size; ++row) {
+        long double y = size - (row + 0.5L);
+        for (int column = 0; column < size; ++column) {
+            long double x = column + 0.5L;
+            cr[column] = dd_from_long_double(view->camera_x + view->scale * (2.0L * x / size - 1.0L));
+            ci[column] = dd_from_long_double(view->camera_y + view->scale * (2.0L * y / size - 1.0L));
+        }
+        kernels->escape_double_double(cr, ci, size, iterations, iters + row * size, NULL, NULL, NULL);
+    }
+
+    free(cr);
+    free(ci);
+}
+
+// Inverse of the brightness written by the shaders, black means the limit
+static int shader_iterations(float bright, int iterations)
+{
+    if (bright <= 0.0f) return iterations;
+    return (int)lroundf(bright * bright * iterations);
+}
+
+int main(int argc, char **argv)
+{
+    int iterations = 500;
+    int size = 400;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+            iterations = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            size = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [-i iterations] [-s size]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (!create_context()) {
+        fprintf(stderr, "ERROR: Could not create an OpenGL 3.3 context\n");
+        return EXIT_FAILURE;
+    }
+    printf("INFO: %dx%d pixels, %d iterations, %s\n", size, size, iterations,
+            (const char *)glGetString(GL_RENDERER));
+
+    ShaderVariant variants[] = {
+        { "float", "mandelbrot.frag", false, 0 },
+        { "double-float", "mandelbrot_df.frag", true, 0 },
+    };
+    int variant_count = sizeof(variants) / sizeof(variants[0]);
+    for (int v = 0; v < variant_count; ++v) {
+        // The double-float shader does not compile without GL_ARB_gpu_shader5
+        variants[v].program = load_program("base.vert", variants[v].path);
+        if (variants[v].program == 0) fprintf(stderr, "WARNING: Skipping the %s shader\n", variants[v].name);
+    }
+
+    // Float target so that the brightness maps back to the iteration count
+    GLuint texture, framebuffer;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, size, size, 0, GL_RED, GL_FLOAT, NULL);
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "ERROR: Could not create the framebuffer\n");
+        return EXIT_FAILURE;
+    }
+    glViewport(0, 0, size, size);
+
+    // Two triangles covering the viewport
+    const GLfloat quad[] = { -1, -1, 0, 1, -1, 0, 1, 1, 0, -1, -1, 0, 1, 1, 0, -1, 1, 0 };
+    GLuint vao, vbo;
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    glGenBuffers(1, &vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, NULL);
+    glEnableVertexAttribArray(0);
+
+    const EscapeKernels *kernels = kernel_select();
+    float *pixels = malloc(size * size * sizeof(*pixels));
+    int *expected = malloc(size * size * sizeof(*expected));
+    if (pixels == NULL || expected == NULL) {
+        fprintf(stderr, "ERROR: Could not allocate the pixel buffers\n");
+        return EXIT_FAILURE;
+    }
+
+    int view_count = sizeof(views) / sizeof(views[0]);
+    for (int w = 0; w < view_count; ++w) {
+        const ShaderView *view = &views[w];
+        reference_iterations(kernels, view, size, iterations, expected);
+
+        for (int v = 0; v < variant_count; ++v) {
+            if (variants[v].program == 0) continue;
+            set_uniforms(&variants[v], view, size, iterations);
+
+            // Best of a few runs, glFinish() waits for the frame to complete
+            double best = -1.0;
+            for (int run = 0; run < BENCH_RUNS; ++run) {
+                double start = bench_now();
+                glDrawArrays(GL_TRIANGLES, 0, 6);
+                glFinish();
+                double elapsed = bench_now() - start;
+                if (best < 0.0 || elapsed < best) best = elapsed;
+            }
+
+            glReadPixels(0, 0, size, size, GL_RED, GL_FLOAT, pixels);
+            long matching = 0;
+            for (int i = 0; i < size * size; ++i) {
+                int expected_iters = (expected[i] == 0) ? iterations : expected[i];
+                if (shader_iterations(pixels[i], iterations) == expected_iters) ++matching;
+            }
+
+            printf("%-8s %-14s %9.1f ms/frame %6.1f%% matching double-double\n",
+                    view->name, variants[v].name, best * 1e3, (double)matching / (size * size) * 100.0);
+        }
+    }
+
+    free(pixels);
+    free(expected);
+
+    return EXIT_SUCCESS;
+}